@@ -0,0 +1,33 @@
+#pragma once
+#ifndef BENCH_H__
+#define BENCH_H__
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace bench
+{
+    /// Best wall-clock time in seconds out of \c runs calls of \c f
+    template <typename Func>
+    inline double seconds(Func f, int runs = 5)
+    {
+        double best = std::numeric_limits<double>::infinity();
+        for (int i = 0; i < runs; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end - start).count());
+        }
+        return best;
+    }
+
+    /// Keep \c value alive, so that the code computing it is not optimized away
+    template <typename T>
+    inline void keep(const T &value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+} // namespace bench
+
+#endif // BENCH_H__
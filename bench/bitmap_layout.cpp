@@ -0,0 +1,91 @@
+/**
+ * Bilinear Bitmap lookups per second, row-major vs. tiled texel layout
+ *
+ * For each storage format, eval() and evalBatch() run over the same 4M
+ * texture coordinates, either uniformly random over the map or a
+ * spatially coherent random walk (steps of about one texel, as along a
+ * ray differential). Usage: bench_bitmap_layout [resolution = 4096]
+ */
+#include "bench.h"
+
+#include <core/bitmap.h>
+#include <core/sampler.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+struct Lookups {
+    const char *name;
+    std::vector<Float> u, v;
+};
+
+/// Million lookups per second of eval() and evalBatch() over \c lookups
+void measure(const Bitmap &bitmap, const Lookups &lookups, double &scalar, double &batch) {
+    const size_t n = lookups.u.size();
+    std::vector<Float> r(n), g(n), b(n);
+    scalar = n * 1e-6 / bench::seconds([&] {
+        Spectrum sum = Spectrum::Zero();
+        for (size_t i = 0; i < n; ++i)
+            sum += bitmap.eval(Vector2(lookups.u[i], lookups.v[i]));
+        bench::keep(sum);
+    });
+    batch = n * 1e-6 / bench::seconds([&] {
+        bitmap.evalBatch(lookups.u.data(), lookups.v.data(), n, r.data(), g.data(), b.data());
+        bench::keep(r[0]);
+    });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int    res   = argc > 1 ? atoi(argv[1]) : 4096;
+    const size_t count = 1 << 22;
+
+    RndSampler sampler(7, 0);
+    ArrayXd texels(3 * (size_t) res * res);
+    for (Eigen::Index i = 0; i < texels.size(); ++i)
+        texels[i] = sampler.next1D();
+
+    Lookups random{ "random" }, walk{ "walk" };
+    for (size_t i = 0; i < count; ++i) {
+        random.u.push_back(sampler.next1D());
+        random.v.push_back(sampler.next1D());
+    }
+    Float u = 0.5, v = 0.5;
+    for (size_t i = 0; i < count; ++i) {
+        u += (2 * sampler.next1D() - 1) / res;
+        v += (2 * sampler.next1D() - 1) / res;
+        u -= std::floor(u);
+        v -= std::floor(v);
+        walk.u.push_back(u);
+        walk.v.push_back(v);
+    }
+
+    const std::pair<const char *, Bitmap::StorageFormat> formats[] = {
+        { "Full", Bitmap::StorageFormat::Full },
+        { "Float32", Bitmap::StorageFormat::Float32 },
+        { "Float16", Bitmap::StorageFormat::Float16 },
+        { "RGBE", Bitmap::StorageFormat::RGBE },
+    };
+
+    printf("%dx%d bitmap, %zu lookups, M lookups/s\n", res, res, count);
+    printf("%-8s %-7s %12s %12s %12s %12s\n", "format", "uv", "eval", "eval tiled",
+           "batch", "batch tiled");
+    for (const auto &[name, format] : formats) {
+        Bitmap bitmap(texels, Vector2i(res, res));
+        bitmap.setStorageFormat(format);
+        for (const Lookups *lookups : { &random, &walk }) {
+            double scalar, batch, scalar_tiled, batch_tiled;
+            bitmap.setLayout(Bitmap::Layout::RowMajor);
+            measure(bitmap, *lookups, scalar, batch);
+            bitmap.setLayout(Bitmap::Layout::Tiled);
+            measure(bitmap, *lookups, scalar_tiled, batch_tiled);
+            printf("%-8s %-7s %12.2f %12.2f %12.2f %12.2f\n", name, lookups->name, scalar,
+                   scalar_tiled, batch, batch_tiled);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * Cost of rebuilding the CubeDistribution of an environment map
+ *
+ *  - append:   the former serial rebuild, clear() + append() per cell + normalize()
+ *  - rebuild:  DiscreteDistribution::rebuild, blocked parallel prefix sum in place
+ *  - set_mass: CubeDistribution::set_mass, batched lookups of the radiance + rebuild
+ *
+ * at 1K, 4K and 8K cell resolutions. The radiance is a fixed 2048 x 1024
+ * random bitmap. Set OMP_NUM_THREADS to compare thread counts.
+ */
+#include "bench.h"
+
+#include <core/bitmap.h>
+#include <core/cube_distrb.h>
+#include <core/pmf.h>
+#include <core/sampler.h>
+
+#include <omp.h>
+#include <cstdio>
+
+int main()
+{
+    RndSampler sampler(13, 0);
+    const Vector2i radiance_res(2048, 1024);
+    ArrayXd texels(3 * radiance_res.prod());
+    for (Eigen::Index i = 0; i < texels.size(); ++i)
+        texels[i] = sampler.next1D();
+    Bitmap radiance(texels, radiance_res);
+
+    printf("%d threads\n", omp_get_max_threads());
+    printf("%-12s %12s %12s %12s\n", "cells", "append [ms]", "rebuild [ms]", "set_mass [ms]");
+
+    const Array2i resolutions[] = { Array2i(1024, 512), Array2i(4096, 2048), Array2i(8192, 4096) };
+    for (const Array2i &res : resolutions) {
+        CubeDistribution cube;
+        cube.set_resolution(res);
+        cube.set_mass(radiance);
+        const size_t n = cube.m_num_cells;
+        const ArrayXd &mass = cube.m_mass;
+
+        DiscreteDistribution distrb;
+        double append = bench::seconds([&] {
+            distrb.clear();
+            distrb.reserve(n);
+            for (size_t i = 0; i < n; ++i)
+                distrb.append(mass[i]);
+            bench::keep(distrb.normalize());
+        });
+        double rebuild = bench::seconds([&] {
+            bench::keep(distrb.rebuild(n, [&](size_t i) { return mass[i]; }));
+        });
+        double set_mass = bench::seconds([&] {
+            cube.set_mass(radiance);
+            bench::keep(cube.m_distrb.getSum());
+        });
+
+        char cells[32];
+        snprintf(cells, sizeof(cells), "%dx%d", res[0], res[1]);
+        printf("%-12s %12.2f %12.2f %12.2f\n", cells, 1e3 * append, 1e3 * rebuild, 1e3 * set_mass);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * Ray-triangle tests per second of the scalar Moller-Trumbore test
+ * (rayIntersectTriangle) against the packet kernels of triangle_simd.h:
+ * TriangleN<NativeWidth> in double and the watertight
+ * TriangleNf<NativeWidthf> in single precision. Every ray is tested
+ * against every triangle of a random soup, as in a BVH leaf.
+ */
+#include "bench.h"
+
+#include <core/sampler.h>
+#include <core/triangle_simd.h>
+#include <core/utils.h>
+
+#include <cstdio>
+#include <vector>
+
+int main() {
+    constexpr int W = simd::NativeWidth, Wf = simd::NativeWidthf;
+    const int triangles = 4096, rays = 4096;
+
+    RndSampler sampler(3, 0);
+    auto point = [&] { return Vector(sampler.next1D(), sampler.next1D(), sampler.next1D()); };
+
+    std::vector<Vector> v0, v1, v2;
+    for (int i = 0; i < triangles; ++i) {
+        Vector c = point();
+        v0.push_back(c + 0.2 * (point() - Vector::Constant(0.5)));
+        v1.push_back(c + 0.2 * (point() - Vector::Constant(0.5)));
+        v2.push_back(c + 0.2 * (point() - Vector::Constant(0.5)));
+    }
+    std::vector<Ray> ray;
+    for (int i = 0; i < rays; ++i) {
+        Vector org = 4 * (point() - Vector::Constant(0.5));
+        ray.emplace_back(org, (point() - org).normalized());
+    }
+
+    std::vector<simd::TriangleN<W>> packs((triangles + W - 1) / W);
+    std::vector<simd::TriangleNf<Wf>> packs32((triangles + Wf - 1) / Wf);
+    for (int i = 0; i < triangles; ++i) {
+        packs[i / W].set(i % W, v0[i], v1[i], v2[i], i);
+        packs32[i / Wf].set(i % Wf, v0[i], v1[i], v2[i], i);
+    }
+
+    long hits = 0, hits_packet = 0, hits_packet32 = 0;
+    double scalar = bench::seconds([&] {
+        hits = 0;
+        for (const Ray &r : ray)
+            for (int i = 0; i < triangles; ++i) {
+                Float u, v, t;
+                hits += rayIntersectTriangle(v0[i], v1[i], v2[i], r, u, v, t);
+            }
+    });
+    double packet = bench::seconds([&] {
+        hits_packet = 0;
+        alignas(64) Float u[W], v[W], t[W];
+        for (const Ray &r : ray)
+            for (const auto &pack : packs)
+                hits_packet += __builtin_popcount(simd::rayIntersect(r, pack, u, v, t));
+    });
+    double packet32 = bench::seconds([&] {
+        hits_packet32 = 0;
+        alignas(64) float u[Wf], v[Wf], t[Wf];
+        for (const Ray &r : ray) {
+            simd::WatertightRay wr(r);
+            for (const auto &pack : packs32)
+                hits_packet32 += __builtin_popcount(simd::rayIntersect(wr, pack, u, v, t));
+        }
+    });
+
+    const double tests = 1e-6 * triangles * rays;
+    char packet_name[32], packet32_name[32];
+    snprintf(packet_name, sizeof(packet_name), "packet TriangleN<%d>", W);
+    snprintf(packet32_name, sizeof(packet32_name), "watertight TriangleNf<%d>", Wf);
+    printf("%d triangles x %d rays, M ray-triangle tests/s\n", triangles, rays);
+    printf("%-28s %10.1f  (%ld hits)\n", "scalar rayIntersectTriangle", tests / scalar, hits);
+    printf("%-28s %10.1f  (%ld hits)\n", packet_name, tests / packet, hits_packet);
+    printf("%-28s %10.1f  (%ld hits)\n", packet32_name, tests / packet32, hits_packet32);
+    return 0;
+}
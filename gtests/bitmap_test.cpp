@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <core/bitmap.h>
+#include <core/sampler.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+/// Texels spread over many magnitudes, stored in \c format and read back
+std::vector<std::pair<Spectrum, Spectrum>> roundTrip(Bitmap::StorageFormat format,
+                                                     Bitmap::Layout layout, Float lo, Float hi) {
+    RndSampler sampler(9, 0);
+    const Vector2i res(19, 11);
+    Bitmap bitmap;
+    bitmap.resize(res);
+    bitmap.setLayout(layout);
+    std::vector<Spectrum> values(res.prod());
+    for (size_t i = 0; i < values.size(); ++i) {
+        for (int c = 0; c < 3; ++c)
+            values[i][c] = std::exp(lo + (hi - lo) * sampler.next1D());
+        bitmap.setTexel(i, values[i]);
+    }
+    // converting from Full goes through the same codec as setTexel()
+    bitmap.setStorageFormat(format);
+    std::vector<std::pair<Spectrum, Spectrum>> ret;
+    for (size_t i = 0; i < values.size(); ++i)
+        ret.emplace_back(values[i], bitmap.texel(i));
+    return ret;
+}
+
+/// A single texel stored in \c format and read back
+Spectrum store(Bitmap::StorageFormat format, const Spectrum &value) {
+    Bitmap bitmap;
+    bitmap.resize(Vector2i(1, 1));
+    bitmap.setStorageFormat(format);
+    bitmap.setTexel(0, value);
+    return bitmap.texel(0);
+}
+
+const Float Inf = std::numeric_limits<Float>::infinity();
+const Float NaN = std::numeric_limits<Float>::quiet_NaN();
+
+} // namespace
+
+TEST(Bitmap, Float32RoundTrip) {
+    for (auto layout : { Bitmap::Layout::RowMajor, Bitmap::Layout::Tiled })
+        for (const auto &[value, stored] : roundTrip(Bitmap::StorageFormat::Float32, layout, -40, 40))
+            for (int c = 0; c < 3; ++c)
+                ASSERT_NEAR(stored[c], value[c], value[c] * std::ldexp(1., -24));
+}
+
+TEST(Bitmap, Float16RoundTrip) {
+    // normal half range: round to nearest with an 11 bit significand
+    for (auto layout : { Bitmap::Layout::RowMajor, Bitmap::Layout::Tiled })
+        for (const auto &[value, stored] : roundTrip(Bitmap::StorageFormat::Float16, layout, -9, 11))
+            for (int c = 0; c < 3; ++c)
+                ASSERT_NEAR(stored[c], value[c], value[c] * std::ldexp(1., -11));
+
+    // overflow to infinity, keep the sign, zero and NaN
+    Spectrum s = store(Bitmap::StorageFormat::Float16, Spectrum(1e6, -1e6, 65504));
+    EXPECT_EQ(s[0], Inf);
+    EXPECT_EQ(s[1], -Inf);
+    EXPECT_EQ(s[2], 65504);
+    s = store(Bitmap::StorageFormat::Float16, Spectrum(0, -0.5, NaN));
+    EXPECT_EQ(s[0], 0);
+    EXPECT_EQ(s[1], -0.5);
+    EXPECT_TRUE(std::isnan(s[2]));
+}
+
+TEST(Bitmap, RGBERoundTrip) {
+    for (auto layout : { Bitmap::Layout::RowMajor, Bitmap::Layout::Tiled })
+        for (const auto &[value, stored] : roundTrip(Bitmap::StorageFormat::RGBE, layout, -30, 30)) {
+            // 8 bit mantissas relative to the shared exponent of the largest component
+            const Float m = value.maxCoeff();
+            for (int c = 0; c < 3; ++c)
+                ASSERT_NEAR(stored[c], value[c], m / 256) << value.transpose();
+            ASSERT_NEAR(stored.maxCoeff(), m, m / 256);
+        }
+}
+
+TEST(Bitmap, RGBEClamping) {
+    const Bitmap::StorageFormat RGBE = Bitmap::StorageFormat::RGBE;
+    // negative components and NaNs store a zero mantissa, which decodes to
+    // half a step of the shared exponent; the other components are kept
+    Spectrum s = store(RGBE, Spectrum(-1, NaN, 2));
+    EXPECT_EQ(s[0], s[1]);
+    EXPECT_LE(s[0], 2. / 256);
+    EXPECT_NEAR(s[2], 2, 2. / 256);
+    EXPECT_TRUE(store(RGBE, Spectrum(-1, -Inf, NaN)).isZero());
+    EXPECT_TRUE(store(RGBE, Spectrum(1e-40, 0, 0)).isZero());
+
+    // +Inf and overly large values saturate at the largest encodable value
+    const Float max = std::ldexp(Float(255.5), 127 - 8);
+    for (Float big : { Float(1e300), Inf }) {
+        s = store(RGBE, Spectrum(big, 1, 0));
+        EXPECT_TRUE(std::isfinite(s[0])) << big;
+        EXPECT_NEAR(s[0], max, max * 1e-12) << big;
+        EXPECT_LE(s[1], max / 256) << big;
+    }
+}
@@ -0,0 +1,287 @@
+#include <gtest/gtest.h>
+
+#include <core/aabb_simd.h>
+#include <core/bvh.h>
+#include <core/sampler.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const Float Inf = std::numeric_limits<Float>::infinity();
+
+struct Scene {
+    std::vector<Vector>   vertices;
+    std::vector<Vector3i> faces;
+};
+
+/// A soup of random triangles in the unit cube above a 16x16 grid on z = 0
+Scene testScene(RndSampler &sampler) {
+    Scene scene;
+    auto point = [&] { return Vector(sampler.next1D(), sampler.next1D(), sampler.next1D()); };
+    for (int i = 0; i < 500; ++i) {
+        Vector c = point();
+        for (int k = 0; k < 3; ++k)
+            scene.vertices.push_back(c + 0.1 * (point() - Vector::Constant(0.5)));
+        scene.faces.emplace_back(3 * i, 3 * i + 1, 3 * i + 2);
+    }
+    const int n = 16, base = (int) scene.vertices.size();
+    for (int y = 0; y <= n; ++y)
+        for (int x = 0; x <= n; ++x)
+            scene.vertices.emplace_back(Float(x) / n, Float(y) / n, 0);
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x) {
+            int v = base + y * (n + 1) + x;
+            scene.faces.emplace_back(v, v + 1, v + n + 2);
+            scene.faces.emplace_back(v, v + n + 2, v + n + 1);
+        }
+    return scene;
+}
+
+/// Random rays around the scene: from outside, from inside, along the axes and clipped
+std::vector<Ray> testRays(RndSampler &sampler) {
+    std::vector<Ray> rays;
+    auto point = [&] { return Vector(sampler.next1D(), sampler.next1D(), sampler.next1D()); };
+    for (int i = 0; i < 4000; ++i) {
+        Vector org    = i % 2 ? Vector(3 * (point() - Vector::Constant(0.5))) : point();
+        Vector target = point();
+        target.z() *= i % 3 == 0 ? 0 : 1;
+        Ray ray(org, (target - org).normalized());
+        if (i % 5 == 0) {
+            // axis-aligned, zero direction components
+            int axis      = i % 3;
+            ray.dir       = Vector::Zero();
+            ray.dir[axis] = i % 2 ? 1 : -1;
+            ray.org[axis] = ray.dir[axis] > 0 ? -1 : 2;
+        }
+        if (i % 7 == 0)
+            ray.tmax = 0.5 + sampler.next1D();
+        if (i % 11 == 0)
+            ray.tmin = 0.2;
+        rays.push_back(ray);
+    }
+    return rays;
+}
+
+/// Closest hit of \c ray over all triangles with the scalar test
+bool bruteForce(const Scene &scene, const Ray &ray, BVH::Hit &hit) {
+    hit = BVH::Hit();
+    Float tmax = ray.tmax;
+    for (size_t i = 0; i < scene.faces.size(); ++i) {
+        const Vector3i &f = scene.faces[i];
+        Float u, v, t;
+        Ray r(ray.org, ray.dir, ray.tmin, tmax);
+        if (rayIntersectTriangle(scene.vertices[f[0]], scene.vertices[f[1]], scene.vertices[f[2]], r, u, v, t)) {
+            hit  = BVH::Hit{ (int) i, u, v, t };
+            tmax = t;
+        }
+    }
+    return hit.isValid();
+}
+
+} // namespace
+
+TEST(BVH, DoubleMatchesBruteForce) {
+    RndSampler sampler(15, 0);
+    Scene scene = testScene(sampler);
+    BVH   bvh(scene.vertices, scene.faces);
+    ASSERT_EQ(bvh.triangleCount(), scene.faces.size());
+
+    int hits = 0;
+    for (const Ray &ray : testRays(sampler)) {
+        BVH::Hit expected, hit;
+        bool     found = bruteForce(scene, ray, expected);
+        ASSERT_EQ(bvh.rayIntersect(ray, hit), found) << ray.org.transpose() << " -> " << ray.dir.transpose();
+        ASSERT_EQ(bvh.rayOccluded(ray), found);
+        if (!found)
+            continue;
+        ++hits;
+        ASSERT_NEAR(hit.t, expected.t, 1e-12 * std::max(Float(1), expected.t));
+        // two triangles can only both be closest on a shared edge
+        if (hit.tri != expected.tri)
+            ASSERT_EQ(hit.t, expected.t);
+    }
+    EXPECT_GT(hits, 1000);
+}
+
+TEST(SIMD, WideSlabTestsMatchScalar) {
+    constexpr int N = 8;
+    RndSampler sampler(16, 0);
+    auto point = [&] { return Vector(sampler.next1D(), sampler.next1D(), sampler.next1D()); };
+
+    for (int iter = 0; iter < 500; ++iter) {
+        simd::AABBN<N> boxes;
+        AABB           box[N];
+        for (int i = 0; i < N - 1; ++i) { // the last lane stays empty
+            Vector a = point(), b = point();
+            box[i] = AABB(a.cwiseMin(b), a.cwiseMax(b));
+            boxes.set(i, box[i]);
+        }
+        Ray ray(3 * (point() - Vector::Constant(0.5)), (point() - Vector::Constant(0.5)).normalized());
+        if (iter % 4 == 0)
+            ray.dir[iter % 3] = 0;
+        if (iter % 3 == 0)
+            ray.tmin = -Inf; // boxes behind the origin count as well
+
+        Float    nearT[N];
+        uint32_t mask = simd::rayIntersect(simd::RayInv(ray), boxes, nearT);
+        EXPECT_FALSE(mask & (1u << (N - 1)));
+        for (int i = 0; i < N - 1; ++i) {
+            Float t;
+            bool  hit = simd::rayIntersect(simd::RayInv(ray), box[i], t);
+            ASSERT_EQ(bool(mask & (1u << i)), hit) << "box " << i;
+            if (hit)
+                ASSERT_EQ(nearT[i], t);
+        }
+
+        // the same with N rays against one box
+        simd::RayN<N> rays;
+        for (int i = 0; i < N; ++i)
+            rays.set(i, ray);
+        rays.disable(N - 1);
+        mask = simd::rayIntersect(rays, box[0], nearT);
+        Float t;
+        ASSERT_EQ(mask, simd::rayIntersect(simd::RayInv(ray), box[0], t) ? (1u << (N - 1)) - 1 : 0u);
+    }
+}
+
+TEST(SIMD, SlabTestHitsCorners) {
+    // rays through a corner of a box must never miss it through rounding,
+    // whether the box lies in front of the origin or behind it
+    RndSampler sampler(17, 0);
+    auto point = [&] { return Vector(sampler.next1D(), sampler.next1D(), sampler.next1D()); };
+    for (int iter = 0; iter < 10000; ++iter) {
+        Vector a = point() - Vector::Constant(0.5), b = a + 1e-3 * point() + Vector::Constant(1e-6);
+        AABB   box(a, b);
+        Vector corner(iter & 1 ? a.x() : b.x(), iter & 2 ? a.y() : b.y(), iter & 4 ? a.z() : b.z());
+        Vector org = 100 * (point() - Vector::Constant(0.5));
+        Ray    ray(org, (corner - org).normalized());
+        if (iter % 2) {
+            ray.dir  = -ray.dir;
+            ray.tmin = -Inf;
+        }
+        simd::AABBN<4> boxes;
+        boxes.set(0, box);
+        Float nearT[4], t;
+        ASSERT_TRUE(simd::rayIntersect(simd::RayInv(ray), box, t)) << "iteration " << iter;
+        ASSERT_EQ(simd::rayIntersect(simd::RayInv(ray), boxes, nearT), 1u) << "iteration " << iter;
+    }
+}
+
+namespace {
+
+/// One ray against N triangles of the scene, compared lane by lane with rayIntersectTriangle
+template <int N>
+void checkPacket(const Scene &scene, const Ray &ray, int first) {
+    simd::TriangleN<N> pack;
+    const int count = std::min<int>(N - 1, (int) scene.faces.size() - first); // leave a lane unused
+    for (int i = 0; i < count; ++i) {
+        const Vector3i &f = scene.faces[first + i];
+        pack.set(i, scene.vertices[f[0]], scene.vertices[f[1]], scene.vertices[f[2]], first + i);
+    }
+    Float u[N], v[N], t[N];
+    uint32_t mask = simd::rayIntersect(ray, pack, u, v, t);
+    ASSERT_EQ(mask >> count, 0u);
+    for (int i = 0; i < count; ++i) {
+        const Vector3i &f = scene.faces[first + i];
+        Float su, sv, st;
+        bool  hit = rayIntersectTriangle(scene.vertices[f[0]], scene.vertices[f[1]], scene.vertices[f[2]],
+                                         ray, su, sv, st);
+        ASSERT_EQ(bool(mask & (1u << i)), hit) << "lane " << i << " of " << N;
+        if (hit) {
+            ASSERT_NEAR(u[i], su, 1e-12);
+            ASSERT_NEAR(v[i], sv, 1e-12);
+            ASSERT_NEAR(t[i], st, 1e-12 * std::max(Float(1), st));
+        }
+    }
+}
+
+} // namespace
+
+TEST(SIMD, PacketMollerTrumboreMatchesScalar) {
+    RndSampler sampler(18, 0);
+    Scene scene = testScene(sampler);
+    const std::vector<Ray> rays = testRays(sampler);
+    for (size_t r = 0; r < rays.size(); r += 4)
+        for (int first = 0; first < (int) scene.faces.size(); first += 7) {
+            checkPacket<simd::NativeWidth>(scene, rays[r], first);
+            checkPacket<5>(scene, rays[r], first); // vector lanes and a scalar tail
+            checkPacket<16>(scene, rays[r], first);
+        }
+
+    // N rays against one triangle
+    constexpr int N = 8;
+    for (size_t i = 0; i < scene.faces.size(); i += 3) {
+        const Vector3i &f = scene.faces[i];
+        simd::RayN<N> packet;
+        for (int k = 0; k < N; ++k)
+            packet.set(k, rays[(i + k * 101) % rays.size()]);
+        Float u[N], v[N], t[N];
+        uint32_t mask = simd::rayIntersect(packet, scene.vertices[f[0]], scene.vertices[f[1]],
+                                           scene.vertices[f[2]], u, v, t);
+        for (int k = 0; k < N; ++k) {
+            Float su, sv, st;
+            bool  hit = rayIntersectTriangle(scene.vertices[f[0]], scene.vertices[f[1]], scene.vertices[f[2]],
+                                             rays[(i + k * 101) % rays.size()], su, sv, st);
+            ASSERT_EQ(bool(mask & (1u << k)), hit) << "triangle " << i << ", ray " << k;
+            if (hit)
+                ASSERT_NEAR(t[k], st, 1e-12 * std::max(Float(1), st));
+        }
+    }
+}
+
+TEST(BVH, MixedMatchesBruteForce) {
+    RndSampler sampler(19, 0);
+    Scene scene = testScene(sampler);
+    BVH   bvh(scene.vertices, scene.faces, BVH::Precision::Mixed);
+    ASSERT_EQ(bvh.precision(), BVH::Precision::Mixed);
+    ASSERT_EQ(bvh.triangleCount(), scene.faces.size());
+
+    // single precision may decide differently within rounding distance of an edge or of tmin/tmax
+    int hits = 0, mismatches = 0;
+    const std::vector<Ray> rays = testRays(sampler);
+    for (const Ray &ray : rays) {
+        BVH::Hit expected, hit;
+        bool     found = bruteForce(scene, ray, expected);
+        bool     mixed = bvh.rayIntersect(ray, hit);
+        ASSERT_EQ(bvh.rayOccluded(ray), mixed);
+        if (mixed != found || (found && hit.tri != expected.tri)) {
+            ++mismatches;
+            continue;
+        }
+        if (!found)
+            continue;
+        ++hits;
+        ASSERT_NEAR(hit.t, expected.t, 1e-5 * std::max(Float(1), expected.t));
+        // refine() falls back to the double precision test for the final hit
+        BVH::refine(scene.vertices, scene.faces, ray, hit);
+        ASSERT_NEAR(hit.t, expected.t, 1e-12 * std::max(Float(1), expected.t));
+        ASSERT_NEAR(hit.u, expected.u, 1e-12);
+        ASSERT_NEAR(hit.v, expected.v, 1e-12);
+    }
+    EXPECT_GT(hits, 1000);
+    EXPECT_LE(mismatches, (int) rays.size() / 500);
+}
+
+TEST(BVH, MixedIsWatertight) {
+    // rays through the vertices and edge midpoints of the grid, where
+    // neighbouring triangles meet, must never slip through
+    RndSampler sampler(20, 0);
+    Scene scene = testScene(sampler);
+    scene.faces.erase(scene.faces.begin(), scene.faces.begin() + 500); // the grid only
+    BVH bvh(scene.vertices, scene.faces, BVH::Precision::Mixed);
+
+    for (int y = 1; y < 32; ++y)
+        for (int x = 1; x < 32; ++x)
+            for (int k = 0; k < 4; ++k) {
+                Vector target(Float(x) / 32, Float(y) / 32, 0);
+                Vector org(sampler.next1D(), sampler.next1D(), 0.5 + sampler.next1D());
+                if (k % 2)
+                    org.z() = -org.z(); // from below
+                BVH::Hit hit;
+                ASSERT_TRUE(bvh.rayIntersect(Ray(org, (target - org).normalized()), hit))
+                    << "target " << target.transpose() << ", origin " << org.transpose();
+            }
+}
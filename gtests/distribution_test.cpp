@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <core/distr_2d.h>
+#include <core/pmf.h>
+#include <core/sampler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+/// Random weights with some zero entries, but no empty row
+std::vector<Float> randomWeights(const Vector2i &res, RndSampler &sampler) {
+    std::vector<Float> data(res.prod());
+    for (Float &w : data)
+        w = sampler.next1D() < 0.2 ? 0 : sampler.next1D();
+    for (int y = 0; y < res.y(); ++y)
+        data[y * res.x() + y % res.x()] += 1;
+    return data;
+}
+
+/// Distribution2D::sample() with full std::lower_bound searches instead of the guide tables
+std::pair<Vector2, Float> sampleFullSearch(const Distribution2D &distrb, const Vector2 &_rnd) {
+    Vector2 rnd(_rnd);
+    const Vector2i &res = distrb.m_res;
+    auto [row, pdf_row] = distrb.sampleReuse(distrb.m_cdfRows.data(), res.y(), rnd.y());
+    auto [col, pdf_col] = distrb.sampleReuse(distrb.m_cdfCols.data() + row * (res.x() + 1),
+                                             res.x(), rnd.x());
+    Vector2 p = Vector2(col, row) + rnd;
+    return { p.array() / res.cast<Float>().array(), pdf_col * pdf_row * res.prod() };
+}
+
+/// Bitwise agreement, a sample at the start of a run of zero entries reuses to NaN on both paths
+bool same(Float a, Float b) { return a == b || (std::isnan(a) && std::isnan(b)); }
+
+} // namespace
+
+TEST(Distribution2D, GuideTableMatchesFullSearch) {
+    RndSampler sampler(1, 0);
+    for (const Vector2i &res : { Vector2i(1, 1), Vector2i(37, 23), Vector2i(64, 32), Vector2i(5, 300) }) {
+        Distribution2D distrb(randomWeights(res, sampler), res);
+
+        std::vector<Vector2> samples = { Vector2(0, 0), Vector2(1, 1), Vector2(0.5, 0.5) };
+        for (int i = 0; i < 10000; ++i)
+            samples.emplace_back(sampler.next1D(), sampler.next1D());
+        // samples on the cdf entries and bucket boundaries are the corner cases of the bracket
+        for (int y = 0; y <= res.y(); ++y)
+            samples.emplace_back(sampler.next1D(), distrb.m_cdfRows[y]);
+        for (uint32_t j = 0; j <= distrb.m_guideSizeCols; ++j)
+            samples.emplace_back(Float(j) / distrb.m_guideSizeCols, sampler.next1D());
+
+        for (const Vector2 &s : samples) {
+            auto [p, pdf]         = distrb.sample(s);
+            auto [p_ref, pdf_ref] = sampleFullSearch(distrb, s);
+            ASSERT_TRUE(same(p.x(), p_ref.x()) && same(p.y(), p_ref.y()) && pdf == pdf_ref)
+                << "res " << res.transpose() << ", sample " << s.transpose();
+        }
+    }
+}
+
+TEST(Distribution2D, GuideTableBracketsLowerBound) {
+    RndSampler sampler(2, 0);
+    std::vector<Float> cdf = { 0 };
+    for (int i = 0; i < 1000; ++i)
+        cdf.push_back(cdf.back() + (i % 7 == 0 ? 0 : sampler.next1D()));
+    for (Float &c : cdf)
+        c /= cdf.back();
+    const uint32_t size = 1000, n = Distribution2D::guideSize(size);
+    std::vector<uint32_t> guide(n + 1);
+    Distribution2D::buildGuide(cdf.data(), size, n, guide.data());
+
+    for (int i = 0; i <= 100000; ++i) {
+        Float    u = i / 100000.;
+        uint32_t first, count;
+        Distribution2D::guideBracket(guide.data(), n, size, u, first, count);
+        size_t expected = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+        ASSERT_LE(first, expected) << "u = " << u;
+        ASSERT_LE(expected, first + count) << "u = " << u;
+    }
+}
+
+TEST(Distribution2D, SampleBatchMatchesSample) {
+    RndSampler sampler(3, 0);
+    const Vector2i res(37, 23);
+    Distribution2D distrb(randomWeights(res, sampler), res);
+
+    // several chunks of simd::BatchChunk and a partial one
+    const size_t count = 3 * simd::BatchChunk + 17;
+    std::vector<Float> samples(2 * count), points(2 * count), pdfs(count);
+    for (Float &s : samples)
+        s = sampler.next1D();
+    samples[0] = samples[1] = 1;
+    distrb.sampleBatch(samples.data(), count, points.data(), pdfs.data());
+
+    for (size_t i = 0; i < count; ++i) {
+        auto [p, pdf] = distrb.sample(Vector2(samples[2 * i], samples[2 * i + 1]));
+        ASSERT_TRUE(same(points[2 * i], p.x()) && same(points[2 * i + 1], p.y()) && pdfs[i] == pdf)
+            << "sample " << i;
+    }
+}
+
+TEST(DiscreteDistribution, SampleBatchMatchesSample) {
+    RndSampler sampler(4, 0);
+    ArrayXd    pmf(1000);
+    for (Eigen::Index i = 0; i < pmf.size(); ++i)
+        pmf[i] = i % 5 == 0 ? 0 : sampler.next1D();
+
+    const size_t count = 3 * simd::BatchChunk + 17;
+    std::vector<Float> samples(count);
+    for (Float &s : samples)
+        s = sampler.next1D();
+    samples[0] = 0;
+    samples[1] = 1;
+
+    for (bool alias : { false, true }) {
+        DiscreteDistribution distrb(pmf, alias);
+        std::vector<uint32_t> indices(count), reuse_indices(count);
+        std::vector<Float>    pdfs(count), reuse_pdfs(count), reused(samples);
+        distrb.sampleBatch(samples.data(), count, indices.data(), pdfs.data());
+        distrb.sampleReuseBatch(reused.data(), count, reuse_indices.data(), reuse_pdfs.data());
+
+        for (size_t i = 0; i < count; ++i) {
+            Float  pdf, reuse_pdf, u = samples[i];
+            size_t index       = distrb.sample(samples[i], pdf);
+            size_t reuse_index = distrb.sampleReuse(u, reuse_pdf);
+            ASSERT_EQ(indices[i], index) << "alias " << alias << ", sample " << i;
+            ASSERT_EQ(pdfs[i], pdf);
+            ASSERT_EQ(reuse_indices[i], reuse_index);
+            ASSERT_EQ(reuse_pdfs[i], reuse_pdf);
+            ASSERT_TRUE(same(reused[i], u));
+        }
+    }
+}
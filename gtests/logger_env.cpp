@@ -0,0 +1,21 @@
+#include <gtest/gtest.h>
+
+#include <core/logger.h>
+
+/*
+ * Linked into every test: Throw() and PSDR_ERROR() log through
+ * Logger::m_logger, which the Python module normally sets up.
+ */
+
+namespace {
+
+struct LoggerEnvironment : public ::testing::Environment {
+    void SetUp() override {
+        if (!Logger::m_logger)
+            Logger::static_init();
+    }
+};
+
+const auto *logger_environment = ::testing::AddGlobalTestEnvironment(new LoggerEnvironment);
+
+} // namespace
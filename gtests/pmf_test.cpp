@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <core/cube_distrb.h>
+#include <core/pmf.h>
+#include <core/sampler.h>
+
+#include <omp.h>
+#include <vector>
+
+namespace {
+
+/// Runs \c f with \c threads OpenMP threads, then restores the previous count
+template <typename Func>
+void withThreads(int threads, Func f) {
+    const int previous = omp_get_max_threads();
+    omp_set_num_threads(threads);
+    f();
+    omp_set_num_threads(previous);
+}
+
+} // namespace
+
+TEST(DiscreteDistribution, RebuildIndependentOfThreadCount) {
+    RndSampler sampler(6, 0);
+    // several RebuildBlocks and a partial one
+    const size_t n = 7 * DiscreteDistribution::RebuildBlock + 123;
+    std::vector<Float> weights(n);
+    for (Float &w : weights)
+        w = sampler.next1D();
+
+    DiscreteDistribution reference;
+    withThreads(1, [&] { reference.rebuild(n, [&](size_t i) { return weights[i]; }); });
+
+    for (int threads : { 2, 3, 8 }) {
+        DiscreteDistribution distrb;
+        withThreads(threads, [&] { distrb.rebuild(n, [&](size_t i) { return weights[i]; }); });
+        ASSERT_EQ(distrb.size(), n);
+        ASSERT_EQ(distrb.getSum(), reference.getSum()) << threads << " threads";
+        for (size_t i = 0; i < n; ++i)
+            ASSERT_EQ(distrb[i], reference[i]) << threads << " threads, entry " << i;
+    }
+}
+
+TEST(DiscreteDistribution, RebuildMatchesAppend) {
+    RndSampler sampler(7, 0);
+    const size_t n = 3 * DiscreteDistribution::RebuildBlock + 5;
+    std::vector<Float> weights(n);
+    for (Float &w : weights)
+        w = sampler.next1D();
+
+    DiscreteDistribution appended, rebuilt;
+    for (Float w : weights)
+        appended.append(w);
+    Float sum = appended.normalize();
+    EXPECT_NEAR(rebuilt.rebuild(n, [&](size_t i) { return weights[i]; }), sum, 1e-9 * sum);
+    EXPECT_TRUE(rebuilt.isNormalized());
+    for (size_t i = 0; i < n; ++i)
+        ASSERT_NEAR(rebuilt[i], appended[i], 1e-12) << "entry " << i;
+
+    // rebuilding in place reuses the distribution for a different size
+    rebuilt.rebuild(10, [](size_t i) { return Float(i + 1); });
+    ASSERT_EQ(rebuilt.size(), 10u);
+    EXPECT_NEAR(rebuilt[9], 10 / 55., 1e-12);
+}
+
+TEST(CubeDistribution, SetMassIndependentOfThreadCount) {
+    RndSampler sampler(8, 0);
+    const Vector2i res(64, 32);
+    ArrayXd texels(3 * res.prod());
+    for (Eigen::Index i = 0; i < texels.size(); ++i)
+        texels[i] = sampler.next1D();
+    Bitmap radiance(texels, res);
+
+    CubeDistribution reference;
+    reference.set_resolution(Array2i(512, 256));
+    withThreads(1, [&] { reference.set_mass(radiance); });
+
+    for (int threads : { 2, 5 }) {
+        CubeDistribution cube;
+        cube.set_resolution(Array2i(512, 256));
+        withThreads(threads, [&] { cube.set_mass(radiance); });
+        ASSERT_TRUE((cube.m_mass == reference.m_mass).all()) << threads << " threads";
+        for (int i = 0; i < cube.m_num_cells; ++i)
+            ASSERT_EQ(cube.m_distrb[i], reference.m_distrb[i]) << threads << " threads, cell " << i;
+    }
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <core/sampler.h>
+#include <core/sampler_pool.h>
+
+#include <omp.h>
+#include <vector>
+
+TEST(RndSampler, AdvanceMatchesSteps) {
+    for (uint64_t delta : { 0ull, 1ull, 2ull, 7ull, 1000ull, 123457ull }) {
+        RndSampler stepped(11, 3), jumped(11, 3);
+        for (uint64_t i = 0; i < delta; ++i)
+            stepped.next_pcg32();
+        jumped.advance(delta);
+        ASSERT_EQ(jumped.state, stepped.state) << "delta " << delta;
+        for (int i = 0; i < 16; ++i)
+            ASSERT_EQ(jumped.next_pcg32(), stepped.next_pcg32());
+    }
+}
+
+TEST(RndSampler, AdvanceBackward) {
+    RndSampler sampler(12, 1);
+    sampler.next_pcg32();
+    const RndSampler start = sampler;
+    std::vector<uint32_t> values(100);
+    for (uint32_t &v : values)
+        v = sampler.next_pcg32();
+
+    // rewinding replays the same numbers
+    sampler.advance(static_cast<uint64_t>(-100));
+    EXPECT_EQ(sampler.state, start.state);
+    for (uint32_t v : values)
+        ASSERT_EQ(sampler.next_pcg32(), v);
+}
+
+TEST(RndSampler, Split) {
+    RndSampler parent(13, 2), copy = parent;
+    RndSampler child = parent.split();
+
+    // consumes four values of the parent
+    copy.advance(4);
+    EXPECT_EQ(parent.state, copy.state);
+    EXPECT_EQ(parent.inc, copy.inc);
+
+    // deterministic, and a different stream than the parent and the next child
+    RndSampler again = RndSampler(13, 2).split();
+    EXPECT_EQ(child.state, again.state);
+    EXPECT_EQ(child.inc, again.inc);
+    RndSampler next = parent.split();
+    EXPECT_NE(child.inc, parent.inc);
+    EXPECT_NE(child.inc, next.inc);
+
+    int equal = 0;
+    for (int i = 0; i < 1000; ++i) {
+        uint32_t c = child.next_pcg32(), n = next.next_pcg32(), p = parent.next_pcg32();
+        equal += (c == n) + (c == p);
+    }
+    EXPECT_LE(equal, 1);
+}
+
+TEST(SamplerPool, StreamsOnlyDependOnWorkItem) {
+    const int items = 200;
+    // first values of every work item, serially and in item order
+    std::vector<uint32_t> expected(items);
+    {
+        SamplerPool pool(14, 1);
+        for (int i = 0; i < items; ++i) {
+            RndSampler parent = pool.m_base;
+            parent.advance(SamplerPool::SplitStride * i);
+            RndSampler reference = parent.split();
+            RndSampler &sampler  = pool.get(i);
+            ASSERT_EQ(sampler.state, reference.state);
+            ASSERT_EQ(sampler.inc, reference.inc);
+            expected[i] = sampler.next_pcg32();
+        }
+    }
+
+    for (int threads : { 1, 3, 8 }) {
+        std::vector<uint32_t> values(items);
+        SamplerPool pool(14, threads);
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+        for (int i = items - 1; i >= 0; --i)
+            values[i] = pool.get(i).next_pcg32();
+        EXPECT_EQ(values, expected) << threads << " threads";
+    }
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <core/simd.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/*
+ * simd::lowerBound() selects its AVX-512 or AVX2 path at compile time, so
+ * gtests/CMakeLists.txt builds this file once per instruction set. Tests
+ * compiled for an instruction set the CPU lacks are skipped.
+ */
+
+namespace {
+
+bool cpuSupported() {
+#if defined(__AVX512F__) && defined(__AVX512VL__)
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl");
+#elif defined(__AVX2__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return true;
+#endif
+}
+
+} // namespace
+
+TEST(SIMD, LowerBoundMatchesStd) {
+    if (!cpuSupported())
+        GTEST_SKIP() << "instruction set not supported by this CPU";
+
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> step(0, 3);
+
+    // sorted data with runs of duplicates
+    std::vector<Float> data(5000);
+    Float value = 0;
+    for (Float &d : data)
+        d = value += step(rng);
+
+    // lanes with empty, single-entry and long ranges, a partial vector at the end
+    const size_t n = 1003;
+    std::vector<uint32_t> first(n), count(n), result(n);
+    std::vector<Float> values(n);
+    std::uniform_int_distribution<uint32_t> start(0, (uint32_t) data.size());
+    std::uniform_real_distribution<Float> query(-2, data.back() + 2);
+    for (size_t i = 0; i < n; ++i) {
+        first[i] = start(rng);
+        const uint32_t remaining = (uint32_t) data.size() - first[i];
+        count[i] = i % 5 == 0 ? std::min<uint32_t>(i % 2, remaining)
+                              : std::uniform_int_distribution<uint32_t>(0, remaining)(rng);
+        // exact entries half of the time
+        values[i] = i % 2 == 0 && count[i] > 0 ? data[first[i] + count[i] / 2] : std::floor(query(rng));
+    }
+
+    simd::lowerBound(data.data(), first.data(), count.data(), values.data(), n, result.data());
+    for (size_t i = 0; i < n; ++i) {
+        const Float *begin = data.data() + first[i], *end = begin + count[i];
+        uint32_t expected = (uint32_t) (std::lower_bound(begin, end, values[i]) - data.data());
+        ASSERT_EQ(result[i], expected) << "lane " << i;
+        ASSERT_EQ(simd::lowerBound(data.data(), first[i], count[i], values[i]), expected);
+    }
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <core/fstream.h>
+#include <core/miniz.h>
+#include <core/sampler.h>
+#include <core/zstream.h>
+
+#include <omp.h>
+#include <vector>
+
+namespace {
+
+const uint32_t Marker = 0xC0FFEE;
+
+/// Compressible data: random bytes from a small alphabet with repeated runs
+std::vector<uint8_t> testData(size_t size) {
+    RndSampler sampler(10, 0);
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i)
+        data[i] = i % 1000 < 500 ? uint8_t(sampler.next_pcg32() % 16) : uint8_t(i / 1000);
+    return data;
+}
+
+struct ZStreamTest : public ::testing::Test {
+    void SetUp() override {
+        path = fs::temp_directory_path() /
+               (std::string("psdr_zstream_test_") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    }
+    void TearDown() override { fs::remove(path); }
+
+    /**
+     * Compress \c data in pieces of \c piece bytes (flushing once in the
+     * middle), followed by an uncompressed marker in the child. Returns the
+     * size of the compressed stream.
+     */
+    size_t compress(const std::vector<uint8_t> &data, size_t piece, size_t parallel_chunk) {
+        FileStream file(path, FileStream::ETruncReadWrite);
+        {
+            ZStream zs(file, ZStream::EDeflate, ZStream::DefaultLevel, parallel_chunk);
+            for (size_t i = 0; i < data.size(); i += piece) {
+                zs.write(data.data() + i, std::min(piece, data.size() - i));
+                if (i < data.size() / 2 && i + piece >= data.size() / 2)
+                    zs.flush();
+            }
+            EXPECT_EQ(zs.tell(), data.size());
+            zs.close();
+        }
+        size_t compressed = file.tell();
+        file.write(Marker);
+        return compressed;
+    }
+
+    /// Decompress \c size bytes and check that the child is left right at the marker
+    std::vector<uint8_t> decompress(size_t size) {
+        FileStream file(path, FileStream::EReadWrite);
+        std::vector<uint8_t> data(size);
+        {
+            ZStream zs(file, ZStream::EInflate);
+            zs.read(data.data(), size);
+            EXPECT_EQ(zs.tell(), size);
+        }
+        uint32_t marker = 0;
+        file.read(marker);
+        EXPECT_EQ(marker, Marker);
+        return data;
+    }
+
+    /// Decompress the first \c compressed bytes of the file with plain miniz
+    std::vector<uint8_t> plainInflate(size_t compressed, size_t size) {
+        FileStream file(path, FileStream::ERead);
+        std::vector<uint8_t> input(compressed), output(size + 1);
+        file.read(input.data(), compressed);
+        mz_ulong output_size = output.size();
+        EXPECT_EQ(mz_uncompress(output.data(), &output_size, input.data(), compressed), MZ_OK);
+        output.resize(output_size);
+        return output;
+    }
+
+    fs::path path;
+};
+
+} // namespace
+
+TEST_F(ZStreamTest, SerialRoundTrip) {
+    const std::vector<uint8_t> data = testData(300000);
+    size_t compressed = compress(data, 7777, 0);
+    EXPECT_LT(compressed, data.size() / 2);
+    EXPECT_EQ(decompress(data.size()), data);
+    EXPECT_EQ(plainInflate(compressed, data.size()), data);
+}
+
+TEST_F(ZStreamTest, ChunkParallelRoundTrip) {
+    const std::vector<uint8_t> data = testData(300000);
+    const int previous = omp_get_max_threads();
+    for (int threads : { 1, 4 }) {
+        omp_set_num_threads(threads);
+        // chunks that do not divide the pieces, the batch or the data
+        size_t compressed = compress(data, 7777, 10000);
+        EXPECT_LT(compressed, data.size() / 2);
+        EXPECT_EQ(decompress(data.size()), data) << threads << " threads";
+        EXPECT_EQ(plainInflate(compressed, data.size()), data) << threads << " threads";
+    }
+    omp_set_num_threads(previous);
+}
+
+TEST_F(ZStreamTest, EmptyStream) {
+    for (size_t chunk : { size_t(0), size_t(4096) }) {
+        size_t compressed = compress({}, 1, chunk);
+        EXPECT_GT(compressed, 0u);
+        EXPECT_TRUE(plainInflate(compressed, 0).empty());
+        decompress(0);
+
+        // reading past the end of the compressed data fails
+        FileStream file(path, FileStream::ERead);
+        ZStream    zs(file, ZStream::EInflate);
+        uint8_t    byte;
+        EXPECT_THROW(zs.read(&byte, 1), std::runtime_error);
+    }
+}
+
+TEST_F(ZStreamTest, Direction) {
+    compress(testData(100), 100, 0);
+    FileStream file(path, FileStream::ERead);
+    EXPECT_THROW(ZStream(file, ZStream::EDeflate), std::runtime_error);
+
+    ZStream zs(file, ZStream::EInflate);
+    EXPECT_TRUE(zs.can_read());
+    EXPECT_FALSE(zs.can_write());
+    uint8_t byte = 0;
+    EXPECT_THROW(zs.write(&byte, 1), std::runtime_error);
+}
@@ -18,6 +18,14 @@ struct AABB
 	/// Copy constructor
 	inline AABB(const AABB &aabb) : min(aabb.min), max(aabb.max) {}
 
+	/// Assignment operator
+	inline AABB &operator=(const AABB &aabb)
+	{
+		min = aabb.min;
+		max = aabb.max;
+		return *this;
+	}
+
 	/// Equality test
 	inline bool operator==(const AABB &aabb) const
 	{
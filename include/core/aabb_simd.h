@@ -0,0 +1,269 @@
+#pragma once
+#ifndef AABB_SIMD_H__
+#define AABB_SIMD_H__
+
+#include <core/aabb.h>
+#include <core/simd.h>
+
+#include <limits>
+
+namespace simd
+{
+    /// Slab distances are widened by 2 gamma(3) so that rounding never misses a box (Ize 2013)
+    constexpr Float SlabRobust = 1 + 4 * std::numeric_limits<Float>::epsilon();
+
+    /// Widen the (already ordered) far distance \c t1 of a slab, away from the near one whatever its sign
+    inline Float slabFar(Float t1)
+    {
+        return t1 * (t1 >= 0 ? SlabRobust : 1 / SlabRobust);
+    }
+
+#if defined(DOUBLE_PRECISION) && defined(__AVX512F__)
+    inline __m512d slabFar(__m512d t1)
+    {
+        __mmask8 positive = _mm512_cmp_pd_mask(t1, _mm512_setzero_pd(), _CMP_GE_OQ);
+        return _mm512_mul_pd(t1, _mm512_mask_blend_pd(positive, _mm512_set1_pd(1 / SlabRobust),
+                                                      _mm512_set1_pd(SlabRobust)));
+    }
+#endif
+#if defined(DOUBLE_PRECISION) && defined(__AVX2__)
+    inline __m256d slabFar(__m256d t1)
+    {
+        __m256d positive = _mm256_cmp_pd(t1, _mm256_setzero_pd(), _CMP_GE_OQ);
+        return _mm256_mul_pd(t1, _mm256_blendv_pd(_mm256_set1_pd(1 / SlabRobust),
+                                                  _mm256_set1_pd(SlabRobust), positive));
+    }
+#endif
+
+    /// Ray with a precomputed reciprocal direction, for repeated box tests
+    struct RayInv
+    {
+        RayInv(const Ray &ray)
+            : org(ray.org), inv_dir(ray.dir.cwiseInverse()), tmin(ray.tmin), tmax(ray.tmax) {}
+
+        Vector org, inv_dir;
+        Float tmin, tmax;
+    };
+
+    /// \c N boxes in SoA layout. Unused lanes should be left empty (see AABB::reset)
+    template <int N>
+    struct AABBN
+    {
+        static_assert(N > 0 && N <= 32, "AABBN: at most 32 lanes");
+
+        AABBN() { reset(); }
+
+        void reset()
+        {
+            for (int a = 0; a < 3; ++a)
+                for (int i = 0; i < N; ++i) {
+                    min[a][i] = std::numeric_limits<Float>::infinity();
+                    max[a][i] = -std::numeric_limits<Float>::infinity();
+                }
+        }
+
+        void set(int i, const AABB &box)
+        {
+            for (int a = 0; a < 3; ++a) {
+                min[a][i] = box.min[a];
+                max[a][i] = box.max[a];
+            }
+        }
+
+        alignas(64) Float min[3][N];
+        alignas(64) Float max[3][N];
+    };
+
+    /// \c N rays in SoA layout with precomputed reciprocal directions
+    template <int N>
+    struct RayN
+    {
+        static_assert(N > 0 && N <= 32, "RayN: at most 32 lanes");
+
+        void set(int i, const Ray &ray)
+        {
+            for (int a = 0; a < 3; ++a) {
+                org[a][i] = ray.org[a];
+                dir[a][i] = ray.dir[a];
+                inv_dir[a][i] = 1 / ray.dir[a];
+            }
+            tmin[i] = ray.tmin;
+            tmax[i] = ray.tmax;
+        }
+
+        /// Make lane \c i miss every box and triangle
+        void disable(int i)
+        {
+            tmin[i] = std::numeric_limits<Float>::infinity();
+            tmax[i] = -std::numeric_limits<Float>::infinity();
+        }
+
+        alignas(64) Float org[3][N];
+        alignas(64) Float dir[3][N];
+        alignas(64) Float inv_dir[3][N];
+        alignas(64) Float tmin[N];
+        alignas(64) Float tmax[N];
+    };
+
+    /**
+     * \brief Slab test of one ray against one box within [ray.tmin, ray.tmax]
+     *
+     * Unlike AABB::rayIntersect there is no division and no branch on
+     * zero directions: a NaN distance (the origin lies in a slab plane
+     * that the ray is parallel to) leaves the interval unchanged. On a hit,
+     * \c nearT receives the entry distance clamped to ray.tmin.
+     */
+    inline bool rayIntersect(const RayInv &ray, const AABB &box, Float &nearT)
+    {
+        Float tmin = ray.tmin, tmax = ray.tmax;
+        for (int a = 0; a < 3; ++a) {
+            Float t0 = (box.min[a] - ray.org[a]) * ray.inv_dir[a], t1 = (box.max[a] - ray.org[a]) * ray.inv_dir[a];
+            if (ray.inv_dir[a] < 0)
+                std::swap(t0, t1);
+            t1 = slabFar(t1);
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+        }
+        nearT = tmin;
+        return tmin <= tmax;
+    }
+
+    /**
+     * \brief One ray against \c N boxes
+     *
+     * Returns a bit mask of the boxes that are hit; nearT[i] receives the
+     * entry distance of box \c i (meaningless when missed). Same semantics
+     * as the scalar version, lane by lane. Eight lanes per instruction with
+     * AVX-512, four with AVX2.
+     */
+    template <int N>
+    inline uint32_t rayIntersect(const RayInv &ray, const AABBN<N> &box, Float *nearT)
+    {
+        uint32_t mask = 0;
+        int i = 0;
+        // the near plane of every box is on the same side for a single ray
+        const Float *lo[3], *hi[3];
+        for (int a = 0; a < 3; ++a) {
+            bool negative = ray.inv_dir[a] < 0;
+            lo[a] = negative ? box.max[a] : box.min[a];
+            hi[a] = negative ? box.min[a] : box.max[a];
+        }
+#if defined(DOUBLE_PRECISION) && defined(__AVX512F__)
+        for (; i + 8 <= N; i += 8)
+        {
+            __m512d tmin = _mm512_set1_pd(ray.tmin), tmax = _mm512_set1_pd(ray.tmax);
+            for (int a = 0; a < 3; ++a)
+            {
+                __m512d org = _mm512_set1_pd(ray.org[a]), inv = _mm512_set1_pd(ray.inv_dir[a]);
+                __m512d t0 = _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(lo[a] + i), org), inv);
+                __m512d t1 = _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(hi[a] + i), org), inv);
+                t1 = slabFar(t1);
+                // max/min return the second operand when either is NaN
+                tmin = _mm512_max_pd(t0, tmin);
+                tmax = _mm512_min_pd(t1, tmax);
+            }
+            _mm512_storeu_pd(nearT + i, tmin);
+            mask |= (uint32_t) _mm512_cmp_pd_mask(tmin, tmax, _CMP_LE_OQ) << i;
+        }
+#elif defined(DOUBLE_PRECISION) && defined(__AVX2__)
+        for (; i + 4 <= N; i += 4)
+        {
+            __m256d tmin = _mm256_set1_pd(ray.tmin), tmax = _mm256_set1_pd(ray.tmax);
+            for (int a = 0; a < 3; ++a)
+            {
+                __m256d org = _mm256_set1_pd(ray.org[a]), inv = _mm256_set1_pd(ray.inv_dir[a]);
+                __m256d t0 = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(lo[a] + i), org), inv);
+                __m256d t1 = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(hi[a] + i), org), inv);
+                t1 = slabFar(t1);
+                // max/min return the second operand when either is NaN
+                tmin = _mm256_max_pd(t0, tmin);
+                tmax = _mm256_min_pd(t1, tmax);
+            }
+            _mm256_storeu_pd(nearT + i, tmin);
+            mask |= (uint32_t) _mm256_movemask_pd(_mm256_cmp_pd(tmin, tmax, _CMP_LE_OQ)) << i;
+        }
+#endif
+        for (; i < N; ++i)
+        {
+            Float tmin = ray.tmin, tmax = ray.tmax;
+            for (int a = 0; a < 3; ++a)
+            {
+                Float t0 = (lo[a][i] - ray.org[a]) * ray.inv_dir[a];
+                Float t1 = slabFar((hi[a][i] - ray.org[a]) * ray.inv_dir[a]);
+                tmin = t0 > tmin ? t0 : tmin;
+                tmax = t1 < tmax ? t1 : tmax;
+            }
+            nearT[i] = tmin;
+            mask |= (uint32_t) (tmin <= tmax) << i;
+        }
+        return mask;
+    }
+
+    /**
+     * \brief \c N rays against one box
+     *
+     * Returns a bit mask of the rays that hit the box; nearT[i] receives
+     * the entry distance of ray \c i. Same semantics as the scalar version,
+     * lane by lane.
+     */
+    template <int N>
+    inline uint32_t rayIntersect(const RayN<N> &ray, const AABB &box, Float *nearT)
+    {
+        uint32_t mask = 0;
+        int i = 0;
+#if defined(DOUBLE_PRECISION) && defined(__AVX512F__)
+        for (; i + 8 <= N; i += 8)
+        {
+            __m512d tmin = _mm512_loadu_pd(ray.tmin + i), tmax = _mm512_loadu_pd(ray.tmax + i);
+            for (int a = 0; a < 3; ++a)
+            {
+                __m512d org = _mm512_loadu_pd(ray.org[a] + i), inv = _mm512_loadu_pd(ray.inv_dir[a] + i);
+                __mmask8 negative = _mm512_cmp_pd_mask(inv, _mm512_setzero_pd(), _CMP_LT_OQ);
+                __m512d bmin = _mm512_set1_pd(box.min[a]), bmax = _mm512_set1_pd(box.max[a]);
+                __m512d t0 = _mm512_mul_pd(_mm512_sub_pd(_mm512_mask_blend_pd(negative, bmin, bmax), org), inv);
+                __m512d t1 = _mm512_mul_pd(_mm512_sub_pd(_mm512_mask_blend_pd(negative, bmax, bmin), org), inv);
+                t1 = slabFar(t1);
+                tmin = _mm512_max_pd(t0, tmin);
+                tmax = _mm512_min_pd(t1, tmax);
+            }
+            _mm512_storeu_pd(nearT + i, tmin);
+            mask |= (uint32_t) _mm512_cmp_pd_mask(tmin, tmax, _CMP_LE_OQ) << i;
+        }
+#elif defined(DOUBLE_PRECISION) && defined(__AVX2__)
+        for (; i + 4 <= N; i += 4)
+        {
+            __m256d tmin = _mm256_loadu_pd(ray.tmin + i), tmax = _mm256_loadu_pd(ray.tmax + i);
+            for (int a = 0; a < 3; ++a)
+            {
+                __m256d org = _mm256_loadu_pd(ray.org[a] + i), inv = _mm256_loadu_pd(ray.inv_dir[a] + i);
+                __m256d negative = _mm256_cmp_pd(inv, _mm256_setzero_pd(), _CMP_LT_OQ);
+                __m256d bmin = _mm256_set1_pd(box.min[a]), bmax = _mm256_set1_pd(box.max[a]);
+                __m256d t0 = _mm256_mul_pd(_mm256_sub_pd(_mm256_blendv_pd(bmin, bmax, negative), org), inv);
+                __m256d t1 = _mm256_mul_pd(_mm256_sub_pd(_mm256_blendv_pd(bmax, bmin, negative), org), inv);
+                t1 = slabFar(t1);
+                tmin = _mm256_max_pd(t0, tmin);
+                tmax = _mm256_min_pd(t1, tmax);
+            }
+            _mm256_storeu_pd(nearT + i, tmin);
+            mask |= (uint32_t) _mm256_movemask_pd(_mm256_cmp_pd(tmin, tmax, _CMP_LE_OQ)) << i;
+        }
+#endif
+        for (; i < N; ++i)
+        {
+            Float tmin = ray.tmin[i], tmax = ray.tmax[i];
+            for (int a = 0; a < 3; ++a)
+            {
+                bool negative = ray.inv_dir[a][i] < 0;
+                Float t0 = ((negative ? box.max[a] : box.min[a]) - ray.org[a][i]) * ray.inv_dir[a][i];
+                Float t1 = slabFar(((negative ? box.min[a] : box.max[a]) - ray.org[a][i]) * ray.inv_dir[a][i]);
+                tmin = t0 > tmin ? t0 : tmin;
+                tmax = t1 < tmax ? t1 : tmax;
+            }
+            nearT[i] = tmin;
+            mask |= (uint32_t) (tmin <= tmax) << i;
+        }
+        return mask;
+    }
+} // namespace simd
+
+#endif // AABB_SIMD_H__
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <core/fstream.h>
+#include <vector>
+
+/**
+ * \brief File stream with a large user-space buffer on top of a raw file
+ * descriptor
+ *
+ * Small reads and writes (e.g. Stream::read<T> of single values) are
+ * served from the buffer. Transfers at least as large as the buffer
+ * bypass it and go straight to the file. All I/O is positional
+ * (pread/pwrite), so seek() only moves the cursor; seeking inside the
+ * buffered read window keeps the buffer.
+ */
+struct BufferedFileStream : public Stream {
+    BufferedFileStream(const fs::path &p,
+                       FileStream::EMode mode = FileStream::ERead,
+                       size_t buffer_size = 1 << 20);
+    virtual ~BufferedFileStream();
+
+    virtual void close() override;
+
+    using Stream::read;
+    using Stream::write;
+
+    virtual void read(void *p, size_t size) override;
+    virtual void write(const void *p, size_t size) override;
+    virtual void seek(size_t pos) override;
+    virtual size_t tell() const override { return m_start + m_offset; }
+    virtual size_t size() const override;
+    virtual void flush() override;
+    virtual bool can_read() const override { return true; }
+    virtual bool can_write() const override { return m_mode != FileStream::ERead; }
+
+    std::string type_name() const override { return "BufferedFileStream"; }
+
+private:
+    /// Write out pending data / drop the read window, keeping the position
+    void flush_buffer();
+    void read_at(void *p, size_t size, size_t offset, size_t requested);
+    void write_at(const void *p, size_t size, size_t offset);
+
+    FileStream::EMode    m_mode;
+    fs::path             m_path;
+    int                  m_fd = -1;
+    std::vector<uint8_t> m_buffer;
+    // The buffer mirrors the file from byte m_start on. It holds either
+    // m_valid bytes read from the file, or m_offset bytes waiting to be
+    // written (m_dirty). The stream position is m_start + m_offset.
+    size_t m_start  = 0;
+    size_t m_offset = 0;
+    size_t m_valid  = 0;
+    bool   m_dirty  = false;
+};
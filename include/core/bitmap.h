@@ -12,42 +12,109 @@ struct Bitmap
         Auto
     };
 
+    /// Compression of the pixel data in saved OpenEXR files
+    enum class Compression
+    {
+        None,
+        ZIP,
+        PIZ
+    };
+
+    /// Type of a single color component
+    enum class ComponentFormat
+    {
+        Float16,
+        Float32
+    };
+
+    /// In-memory representation of the texels
+    enum class StorageFormat
+    {
+        Full,    ///< One Spectrum per texel, stored in m_data
+        Float32, ///< Three floats per texel
+        Float16, ///< Three halfs per texel
+        RGBE     ///< Ward's shared-exponent format, 4 bytes per texel, clamps negative values to 0
+    };
+
+    /// Order of the texels in memory
+    enum class Layout
+    {
+        RowMajor, ///< Scanline by scanline
+        Tiled     ///< Row-major grid of TileSize x TileSize blocks, row-major inside a block
+    };
+
+    static constexpr int TileShift = 3;
+    static constexpr int TileSize = 1 << TileShift;
+
     Bitmap() {}
     Bitmap(const Spectrum &value)
     {
         fill(value);
     }
-    Bitmap(const char *filename)
+    Bitmap(const char *filename, StorageFormat format = StorageFormat::Full)
     {
-        load(filename);
+        load(filename, format);
     }
     Bitmap(const ArrayXd &data, const Vector2i &res);
 
     Bitmap operator+(const Bitmap &rhs) const
     {
         Bitmap ret = *this;
-        for (int i = 0; i < m_data.size(); ++i)
-            ret.m_data[i] += rhs.m_data[i];
+        ret += rhs;
         return ret;
     }
 
-    Bitmap &operator+=(const Bitmap &rhs)
-    {
-        for (int i = 0; i < m_data.size(); ++i)
-            m_data[i] += rhs.m_data[i];
-        return *this;
-    }
+    Bitmap &operator+=(const Bitmap &rhs);
     void setZero();
     std::string toString() const;
-    void load(const char *filename);
-    void save(const char *filename) const;
+    void load(const char *filename, StorageFormat format = StorageFormat::Full);
+    void save(const char *filename,
+              Compression compression = Compression::None,
+              ComponentFormat format = ComponentFormat::Float16) const;
     void fill(const Spectrum &value);
     Spectrum eval(const Vector2 &_uv, bool flip_v = true) const;
+    /// Row-major indices and weights of the (up to) four texels eval() blends at \c uv
+    void evalFootprint(const Vector2 &uv, bool flip_v, int index[4], Float weight[4]) const;
+    /**
+     * \brief Same as calling eval() on \c count points
+     * Coordinates and results are separate arrays (SoA). Row-major Full and
+     * Float32 bitmaps are filtered four lookups at a time with AVX2 gathers.
+     */
+    void evalBatch(const Float *u, const Float *v, size_t count,
+                   Float *r, Float *g, Float *b, bool flip_v = true) const;
     ArrayXd getData() const;
     void setData(const ArrayXd &data);
+    /// getData() without the copy: a writable view of m_data (row-major Full bitmaps only)
+    Eigen::Map<Eigen::Array<Float, Eigen::Dynamic, 1>> dataView();
+    Eigen::Map<const Eigen::Array<Float, Eigen::Dynamic, 1>> dataView() const;
     int width() const { return m_res.x(); }
     int height() const { return m_res.y(); }
 
+    /// Change the resolution, all texels are set to zero
+    void resize(const Vector2i &res);
+    /// Convert the texels to another storage format (lossy for the compact ones)
+    void setStorageFormat(StorageFormat format);
+    StorageFormat storageFormat() const { return m_format; }
+    /// Bytes per texel of a storage format
+    static size_t texelSize(StorageFormat format);
+    /// Reorder the texels, lookups and getData()/setData() are unaffected
+    void setLayout(Layout layout);
+    Layout layout() const { return m_layout; }
+    /// Texel \c i in row-major order (whatever the layout), converted to a Spectrum
+    Spectrum texel(size_t i) const;
+    void setTexel(size_t i, const Spectrum &value);
+
     Vector2i m_res;
+    /// Texels in StorageFormat::Full, empty otherwise
     std::vector<Spectrum> m_data;
+    /// Texels in the compact formats, texelSize(m_format) bytes each
+    std::vector<uint8_t> m_packed;
+    StorageFormat m_format = StorageFormat::Full;
+    Layout m_layout = Layout::RowMajor;
+
+private:
+    /// Size the storage for the current resolution, format and layout
+    void allocate();
+    /// Position in the storage of texel \c i in row-major order
+    size_t storageIndex(size_t i) const;
 };
@@ -0,0 +1,66 @@
+#pragma once
+#include <omp.h>
+
+#include <core/bitmap.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \brief Sparse per-thread gradient accumulator for the texels of a Bitmap
+ *
+ * Unlike TypeAD<T, true>, which keeps a dense copy of the gradient per
+ * worker, every OpenMP thread only allocates the TileSize x TileSize tiles
+ * it actually writes to, and indexes them with a hash map. A thread touching
+ * n texels costs O(n) memory, independent of the bitmap resolution.
+ *
+ * Accumulation never synchronizes: each thread writes to its own tiles.
+ * merge() then reduces tile by tile in parallel. Each tile of the output
+ * is owned by exactly one task, so the merge needs no locks or atomics
+ * either.
+ */
+struct BitmapGrad
+{
+    static constexpr int TileShift = Bitmap::TileShift;
+    static constexpr int TileSize = Bitmap::TileSize;
+
+    explicit BitmapGrad(const Vector2i &res, int nworker = omp_get_max_threads());
+
+    /// Add \c grad to texel (x, y) in the calling thread's buffer
+    void accumulate(int x, int y, const Spectrum &grad);
+    /// Adjoint of Bitmap::eval(uv, flip_v) with respect to the texels
+    void accumulateEval(const Bitmap &bitmap, const Vector2 &uv, const Spectrum &d_out,
+                        bool flip_v = true);
+
+    /// Add the sum of all thread buffers to \c grad (same layout as Bitmap::getData)
+    void merge(ArrayXd &grad) const;
+    /// Dense sum of all thread buffers
+    ArrayXd grad() const;
+    /// Zero the accumulated gradients, allocated tiles are kept for reuse
+    void setZero();
+    /// Release every tile
+    void clear();
+    /// Number of tiles allocated over all threads
+    size_t allocatedTiles() const;
+
+    struct Tile
+    {
+        Spectrum texel[TileSize * TileSize];
+    };
+
+    struct alignas(64) Slot
+    {
+        std::unordered_map<int, Tile *> directory; // tile index -> tile, touched tiles only
+        std::vector<std::unique_ptr<Tile>> tiles;
+    };
+
+    Vector2i m_res;
+    Vector2i m_tiles;
+    std::vector<Slot> m_slots;
+
+private:
+    Slot &slot();
+    /// Indices of the tiles touched by any thread
+    std::vector<int> touchedTiles() const;
+};
@@ -0,0 +1,141 @@
+#pragma once
+#ifndef BVH_H__
+#define BVH_H__
+
+#include <core/aabb.h>
+#include <core/ray.h>
+#include <core/triangle_simd.h>
+#include <core/utils.h>
+
+#include <vector>
+
+/**
+ * \brief Bounding volume hierarchy over a triangle mesh
+ *
+ * Built top-down with a binned surface area heuristic (BinCount bins along
+ * the largest centroid axis). Subtrees are built as OpenMP tasks. Nodes are
+ * stored in one flat array and the two children of an interior node are
+ * adjacent, so a traversal step touches a single pair of cache lines.
+ * Leaves reference a contiguous range of triangles, stored in leaf order
+ * as SoA packs of PackSize that are tested against a ray in one shot.
+ *
+ * With Precision::Mixed the tree is stored in single precision instead:
+ * 32 byte nodes with outward rounded bounds and one pack of up to
+ * PackSize32 float triangles per leaf, the lane count of the widest
+ * watertight kernel (leaves may exceed MaxLeafSize). Hits then carry
+ * single precision barycentrics and distance; refine() recomputes them in
+ * double.
+ *
+ * Traversal only computes the primal hit (triangle, barycentrics, distance).
+ * To differentiate, replay the final hit with hitPointAD on the
+ * differentiable copy of the vertices:
+ *
+ *     BVH::Hit hit;
+ *     if (bvh.rayIntersect(ray, hit))
+ *         p = BVH::hitPointAD(vertices, faces, hit, ray); // Enzyme-active
+ */
+struct BVH
+{
+    static constexpr int BinCount    = 16;
+    static constexpr int MaxLeafSize = 8;
+    static constexpr int MaxDepth    = 64;
+    static constexpr int PackSize    = simd::NativeWidth;  // 8 with AVX-512, 4 otherwise
+    static constexpr int PackSize32  = simd::NativeWidthf; // 16 with AVX-512, 8 otherwise
+
+    enum class Precision
+    {
+        Double, // double precision nodes, Moller-Trumbore on PackSize triangles
+        Mixed   // single precision nodes, watertight test on PackSize32 triangles
+    };
+
+    using TrianglePack = simd::TriangleN<PackSize>;
+    using TrianglePack32 = simd::TriangleNf<PackSize32>;
+
+    struct alignas(64) Node
+    {
+        AABB bounds;
+        uint32_t offset; // leaf: first triangle, interior: left child (the right child follows it)
+        uint16_t count;  // number of triangles, 0 for interior nodes
+        uint16_t axis;   // split axis of interior nodes
+        uint32_t pack;   // leaf: first triangle pack
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    /// Node of the single precision tree
+    struct alignas(32) Node32
+    {
+        float min[3], max[3];
+        uint32_t offset; // leaf: triangle pack, interior: left child (the right child follows it)
+        uint16_t count;
+        uint16_t axis;
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    struct Hit
+    {
+        int tri = -1; // index into the faces the BVH was built from
+        Float u, v, t;
+
+        bool isValid() const { return tri >= 0; }
+    };
+
+    BVH() = default;
+    BVH(const std::vector<Vector> &vertices, const std::vector<Vector3i> &faces,
+        Precision precision = Precision::Double)
+    {
+        build(vertices, faces, precision);
+    }
+
+    void build(const std::vector<Vector> &vertices, const std::vector<Vector3i> &faces,
+               Precision precision = Precision::Double);
+
+    /// Closest hit in [ray.tmin, ray.tmax], as reported by rayIntersectTriangle
+    [[nodiscard]] bool rayIntersect(const Ray &ray, Hit &hit) const;
+    /// Whether any triangle is hit in [ray.tmin, ray.tmax]
+    [[nodiscard]] bool rayOccluded(const Ray &ray) const;
+
+    /// Recompute the barycentrics and distance of \c hit in double precision
+    static void refine(const std::vector<Vector> &vertices, const std::vector<Vector3i> &faces,
+                       const Ray &ray, Hit &hit)
+    {
+        const Vector3i &f = faces[hit.tri];
+        Array uvt = rayIntersectTriangle(vertices[f[0]], vertices[f[1]], vertices[f[2]], ray);
+        hit.u = uvt[0];
+        hit.v = uvt[1];
+        hit.t = uvt[2];
+    }
+
+    /// Hit point of \c hit recomputed from \c vertices with rayIntersectTriangleAD
+    static Vector hitPointAD(const std::vector<Vector> &vertices, const std::vector<Vector3i> &faces,
+                             const Hit &hit, const Ray &ray)
+    {
+        const Vector3i &f = faces[hit.tri];
+        return rayIntersectTriangleAD(vertices[f[0]], vertices[f[1]], vertices[f[2]], ray);
+    }
+
+    const AABB &bounds() const { return m_bounds; }
+    bool empty() const { return m_indices.empty(); }
+    Precision precision() const { return m_precision; }
+    size_t nodeCount() const { return m_precision == Precision::Mixed ? m_nodes32.size() : m_nodes.size(); }
+    size_t triangleCount() const { return m_indices.size(); }
+
+    std::string toString() const;
+
+    Precision m_precision = Precision::Double;
+    AABB m_bounds;
+    std::vector<Node> m_nodes;
+    std::vector<TrianglePack> m_packs;     // leaf triangles, each leaf starts a new pack
+    std::vector<Node32> m_nodes32;         // Precision::Mixed only
+    std::vector<TrianglePack32> m_packs32; // Precision::Mixed only, one per leaf
+    std::vector<int> m_indices;            // leaf order -> original triangle index
+
+private:
+    template <bool Any>
+    bool traverse(const Ray &ray, Hit &hit) const;
+    template <bool Any>
+    bool traverse32(const Ray &ray, Hit &hit) const;
+};
+
+#endif // BVH_H__
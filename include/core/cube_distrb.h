@@ -1,20 +1,33 @@
 #pragma once
 #include <core/bitmap.h>
 #include <core/fwd.h>
+#include <core/hierarchical_distrb.h>
 #include <core/pmf.h>
 
 struct CubeDistribution {
     void set_resolution(const Array2i &res);
     void set_mass(const Bitmap &pmf);
+    /// Recompute the mass of the cells in [lo, hi) only (cell coordinates)
+    void update_mass(const Bitmap &pmf, const Array2i &lo, const Array2i &hi);
+    /// Sample through a mip pyramid instead of one flat CDF (rebuilds from the current mass if any)
+    void set_hierarchical(bool hierarchical);
 
     Float sample_reuse(Vector2 &samples) const;
     Float pdf(const Vector2 &p) const;
 
-    DiscreteDistribution m_distrb;
+    DiscreteDistribution       m_distrb;
+    HierarchicalDistribution2D m_hdistrb;
+    ArrayXd                    m_mass;
+    std::vector<Float>         m_sin_theta;
 
     Array2i         m_res;
     int             m_num_cells;
     Eigen::ArrayX2i m_cells;
     Vector2         m_unit;
-    bool            m_ready = false;
-};
\ No newline at end of file
+    bool            m_hierarchical = false;
+    bool            m_ready        = false;
+
+private:
+    void eval_mass(const Bitmap &radiance, const Array2i &lo, const Array2i &hi);
+    void build_distrb();
+};
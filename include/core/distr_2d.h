@@ -1,6 +1,7 @@
 #pragma once
 #include <core/fwd.h>
 #include <core/logger.h>
+#include <core/simd.h>
 
 #include <vector>
 
@@ -46,6 +47,47 @@ struct Distribution2D {
             PSDR_ERROR("Distribution2D: sum of all entries is zero!");
         if (!std::isfinite(rowSum))
             PSDR_ERROR("Distribution2D: sum of all entries is not finite!");
+
+        /** build the guide tables that bracket the cdf searches */
+        m_guideSizeRows = guideSize(m_res.y());
+        m_guideSizeCols = guideSize(m_res.x());
+        m_guideRows.resize(m_guideSizeRows + 1);
+        m_guideCols.resize((m_guideSizeCols + 1) * m_res.y());
+        buildGuide(m_cdfRows.data(), m_res.y(), m_guideSizeRows,
+                   m_guideRows.data());
+        for (int y = 0; y < m_res.y(); y++)
+            buildGuide(m_cdfCols.data() + y * (m_res.x() + 1), m_res.x(),
+                       m_guideSizeCols,
+                       m_guideCols.data() + y * (m_guideSizeCols + 1));
+    }
+
+    /**
+     * Number of guide table buckets for a cdf with \c size intervals.
+     * A power of two keeps \c sample * buckets exact, so a sample always
+     * falls into the bucket its guide entries were built for.
+     */
+    static uint32_t guideSize(uint32_t size) {
+        uint32_t n = 1;
+        while (n * 2 <= size && n < (1u << 30))
+            n *= 2;
+        return n;
+    }
+
+    /**
+     * guide[j] is the first cdf entry that is >= j / n, i.e. the result of
+     * std::lower_bound for the left end of bucket j (j = 0, ..., n - 1).
+     * guide[n] = size so that the last bucket also covers samples >= 1.
+     */
+    static void buildGuide(const Float *cdf, uint32_t size, uint32_t n,
+                           uint32_t *guide) {
+        uint32_t i = 0;
+        for (uint32_t j = 0; j < n; j++) {
+            Float t = static_cast<Float>(j) / static_cast<Float>(n);
+            while (i <= size && cdf[i] < t)
+                i++;
+            guide[j] = i;
+        }
+        guide[n] = size;
     }
 
     /** first sample the marginal row distribution, then sample the conditional
@@ -54,6 +96,37 @@ struct Distribution2D {
     sampleReuse(const Float *cdf, uint32_t size, Float &sample) const {
         // sample
         const Float *entry = std::lower_bound(cdf, cdf + size + 1, sample);
+        return reuse(cdf, size, entry, sample);
+    }
+
+    /** same as above, but only searches the bracket given by the guide
+     * table. Returns exactly the same index as the full search. */
+    inline std::pair<uint32_t, Float>
+    sampleReuse(const Float *cdf, uint32_t size, const uint32_t *guide,
+                uint32_t guideSize, Float &sample) const {
+        uint32_t first, count;
+        guideBracket(guide, guideSize, size, sample, first, count);
+        const Float *entry = std::lower_bound(cdf + first, cdf + first + count, sample);
+        return reuse(cdf, size, entry, sample);
+    }
+
+    /** the range of cdf entries that contains the std::lower_bound of \c sample */
+    static inline void guideBracket(const uint32_t *guide, uint32_t guideSize,
+                                    uint32_t size, Float sample,
+                                    uint32_t &first, uint32_t &count) {
+        // locate the bucket, NaN and out-of-range samples end up clamped
+        Float    scaled = sample * static_cast<Float>(guideSize);
+        uint32_t bucket = scaled > 0 ? static_cast<uint32_t>(std::min(
+                                           scaled, static_cast<Float>(guideSize - 1)))
+                                     : 0;
+        // the answer lies in [guide[bucket], guide[bucket + 1]]
+        first = guide[bucket];
+        count = std::min(guide[bucket + 1] + 1, size + 1) - first;
+    }
+
+    inline std::pair<uint32_t, Float>
+    reuse(const Float *cdf, uint32_t size, const Float *entry,
+          Float &sample) const {
         // clamp
         uint32_t index = std::min(
             (uint32_t) std::max((ptrdiff_t) 0, entry - cdf - 1), size - 1);
@@ -65,14 +138,69 @@ struct Distribution2D {
     // return the warped sample and associated pdf
     std::pair<Vector2, Float> sample(const Vector2 &_rnd) const {
         Vector2 rnd(_rnd);
-        auto [row, pdf_row] = sampleReuse(m_cdfRows.data(), m_res.y(), rnd.y());
+        auto [row, pdf_row] = sampleReuse(m_cdfRows.data(), m_res.y(),
+                                          m_guideRows.data(), m_guideSizeRows,
+                                          rnd.y());
         auto [col, pdf_col] = sampleReuse(
-            m_cdfCols.data() + row * (m_res.x() + 1), m_res.x(), rnd.x());
+            m_cdfCols.data() + row * (m_res.x() + 1), m_res.x(),
+            m_guideCols.data() + row * (m_guideSizeCols + 1), m_guideSizeCols,
+            rnd.x());
         Vector2 p = Vector2(col, row) + rnd;
         return { p.array() / m_res.cast<Float>().array(),
                  pdf_col * pdf_row * m_res.prod() };
     }
 
+    /**
+     * batched version of sample(): \c samples and \c points hold \c count
+     * interleaved (x, y) pairs. Produces exactly the same points and pdfs as
+     * calling sample() on each pair; the cdf searches of several samples
+     * are interleaved via simd::lowerBound().
+     */
+    void sampleBatch(const Float *samples, size_t count, Float *points,
+                     Float *pdfs) const {
+        const uint32_t sizeRows = m_res.y(), sizeCols = m_res.x();
+        const Float    prod     = m_res.prod();
+        uint32_t       first[simd::BatchChunk], len[simd::BatchChunk],
+            entry[simd::BatchChunk], row[simd::BatchChunk];
+        Float rnd[simd::BatchChunk], pdfRow[simd::BatchChunk];
+
+        for (size_t i = 0; i < count; i += simd::BatchChunk) {
+            size_t n = std::min(simd::BatchChunk, count - i);
+            const Float *in  = samples + 2 * i;
+            Float       *out = points + 2 * i;
+
+            // marginal rows
+            for (size_t k = 0; k < n; k++) {
+                rnd[k] = in[2 * k + 1];
+                guideBracket(m_guideRows.data(), m_guideSizeRows, sizeRows,
+                             rnd[k], first[k], len[k]);
+            }
+            simd::lowerBound(m_cdfRows.data(), first, len, rnd, n, entry);
+            for (size_t k = 0; k < n; k++) {
+                auto [r, pdf] = reuse(m_cdfRows.data(), sizeRows,
+                                      m_cdfRows.data() + entry[k], rnd[k]);
+                row[k]        = r;
+                pdfRow[k]     = pdf;
+                out[2 * k + 1] = (r + rnd[k]) / static_cast<Float>(m_res.y());
+            }
+
+            // conditional columns, searched in the flattened m_cdfCols
+            for (size_t k = 0; k < n; k++) {
+                rnd[k] = in[2 * k];
+                guideBracket(m_guideCols.data() + row[k] * (m_guideSizeCols + 1),
+                             m_guideSizeCols, sizeCols, rnd[k], first[k], len[k]);
+                first[k] += row[k] * (sizeCols + 1);
+            }
+            simd::lowerBound(m_cdfCols.data(), first, len, rnd, n, entry);
+            for (size_t k = 0; k < n; k++) {
+                const Float *cdf = m_cdfCols.data() + row[k] * (sizeCols + 1);
+                auto [c, pdf]    = reuse(cdf, sizeCols, m_cdfCols.data() + entry[k], rnd[k]);
+                out[2 * k]       = (c + rnd[k]) / static_cast<Float>(m_res.x());
+                pdfs[i + k]      = pdf * pdfRow[k] * prod;
+            }
+        }
+    }
+
     std::vector<Float> pdfRows() const { return m_pdfRows; }
     std::vector<Float> cdfRows() const { return m_cdfRows; }
     std::vector<Float> cdfCols() const { return m_cdfCols; }
@@ -81,4 +209,10 @@ struct Distribution2D {
     std::vector<Float> m_cdfRows; // marginal cdf
     std::vector<Float> m_cdfCols; // conditional cdf
     Vector2i           m_res;
+
+    // guide tables: bucket -> first candidate cdf entry
+    std::vector<uint32_t> m_guideRows;
+    std::vector<uint32_t> m_guideCols;
+    uint32_t              m_guideSizeRows = 1;
+    uint32_t              m_guideSizeCols = 1;
 };
\ No newline at end of file
@@ -23,7 +23,19 @@ struct FileStream : public Stream {
 
     virtual void close() override;
 
+    using Stream::read;
+    using Stream::write;
+
     virtual void read(void *p, size_t size) override;
+    virtual void write(const void *p, size_t size) override;
+    virtual void seek(size_t pos) override;
+    virtual size_t tell() const override;
+    virtual size_t size() const override;
+    virtual void flush() override;
+    virtual bool can_read() const override { return true; }
+    virtual bool can_write() const override { return m_mode != ERead; }
+
+    const fs::path &path() const { return m_path; }
 
     std::string type_name() const override { return "FileStream"; }
 
@@ -0,0 +1,53 @@
+#pragma once
+#include <core/fwd.h>
+
+#include <vector>
+
+/**
+ * \brief Hierarchical sample warping over a 2D grid of cells
+ *
+ * Stores a mip pyramid of the (unnormalized) cell masses. Sampling descends
+ * from the 1x1 top level to the finest level, picking one of the four
+ * children at every step and reusing the sample, so it costs O(log n) with
+ * a single 4-entry block read per level. The children of every node are
+ * stored contiguously (quad order).
+ *
+ * Cells are indexed like CubeDistribution: cell (x, y) has index
+ * x * res[1] + y, and the unit square is mapped so that x follows the first
+ * coordinate.
+ */
+struct HierarchicalDistribution2D {
+    void set_resolution(const Array2i &res);
+    /// Rebuild the whole pyramid, \c mass holds one entry per cell
+    void set_mass(const ArrayXd &mass);
+    /// Only re-read the cells in [lo, hi) and refresh their ancestors
+    void update_mass(const ArrayXd &mass, const Array2i &lo, const Array2i &hi);
+
+    Float sample_reuse(Vector2 &samples) const;
+    Float pdf(const Vector2 &p) const;
+    /// Unnormalized mass of a cell
+    Float mass(int x, int y) const;
+    /// Sum of all cell masses
+    Float sum() const { return m_sum; }
+
+    Array2i m_res;
+    int     m_num_cells = 0;
+    // m_levels[l] holds level l in quad order, level 0 is the finest one.
+    // The 1x1 top level is m_sum.
+    std::vector<ArrayXd> m_levels;
+    // m_dims[l] is the resolution of level l (including the top level)
+    std::vector<Array2i> m_dims;
+    Float                m_sum = 0;
+
+private:
+    inline size_t quad_index(int level, int x, int y) const {
+        return 4 * ((size_t) (y >> 1) * m_dims[level + 1][0] + (x >> 1)) +
+               ((y & 1) << 1) + (x & 1);
+    }
+    /// Sum of the four children of node (x, y) at level \c level + 1
+    inline Float child_sum(int level, int x, int y) const {
+        const Float *q = m_levels[level].data() + 4 * ((size_t) y * m_dims[level + 1][0] + x);
+        return (q[0] + q[1]) + (q[2] + q[3]);
+    }
+    void refresh(Array2i lo, Array2i hi);
+};
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef INTERSECTOR_H__
+#define INTERSECTOR_H__
+
+#include <core/ray.h>
+#include <core/utils.h>
+
+#include <vector>
+
+struct RTCDeviceTy;
+struct RTCSceneTy;
+
+/**
+ * \brief Ray-triangle intersector backed by an Embree scene
+ *
+ * Meshes are uploaded once with addMesh() (Embree keeps its own single
+ * precision copy) and the acceleration structure is built by commit().
+ * Queries are available per ray, as packets of 4, 8 or 16 rays and as
+ * ray streams. Every query only returns the primal hit (mesh, triangle,
+ * barycentrics, distance). Embree traverses in single precision, so for
+ * differentiation recompute the hit point with hitPointAD on the double
+ * precision (differentiable) vertices.
+ *
+ * Queries are thread-safe once the scene is committed.
+ *
+ * Only part of libcore when it is built with Embree (PSDR_USE_EMBREE), in
+ * which case PSDR_HAS_EMBREE is defined; BVH is the fallback otherwise.
+ */
+struct Intersector
+{
+    struct Hit
+    {
+        int shape = -1; // value returned by addMesh
+        int tri = -1;   // face index within the mesh
+        Float u, v, t;
+
+        bool isValid() const { return tri >= 0; }
+    };
+
+    Intersector();
+    ~Intersector();
+
+    Intersector(const Intersector &) = delete;
+    Intersector &operator=(const Intersector &) = delete;
+
+    /// Upload a triangle mesh, returns its shape index. Invalidates the scene until commit()
+    int addMesh(const std::vector<Vector> &vertices, const std::vector<Vector3i> &faces);
+    /// Build the acceleration structure
+    void commit();
+
+    /// Closest hit in [ray.tmin, ray.tmax]
+    [[nodiscard]] bool rayIntersect(const Ray &ray, Hit &hit) const;
+    /// Whether anything is hit in [ray.tmin, ray.tmax]
+    [[nodiscard]] bool rayOccluded(const Ray &ray) const;
+
+    /**
+     * Closest hits of a packet of \c N (4, 8 or 16) rays. Lanes with
+     * valid[i] == 0 are skipped and leave hits[i] invalid; \c valid may
+     * be null when all lanes are active.
+     */
+    template <int N>
+    void rayIntersectPacket(const Ray *rays, Hit *hits, const int *valid = nullptr) const;
+
+    /**
+     * Closest hits of \c count rays. Rays are handed to Embree in blocks
+     * that are traced in parallel; \c coherent enables Embree's
+     * optimizations for rays with similar origins and directions
+     * (camera rays).
+     */
+    void rayIntersectStream(const Ray *rays, size_t count, Hit *hits, bool coherent = false) const;
+
+    /// Hit point of \c hit recomputed from \c vertices with rayIntersectTriangleAD
+    static Vector hitPointAD(const std::vector<Vector> &vertices, const std::vector<Vector3i> &faces,
+                             const Hit &hit, const Ray &ray)
+    {
+        const Vector3i &f = faces[hit.tri];
+        return rayIntersectTriangleAD(vertices[f[0]], vertices[f[1]], vertices[f[2]], ray);
+    }
+
+    int shapeCount() const { return m_shapes; }
+
+private:
+    RTCDeviceTy *m_device = nullptr;
+    RTCSceneTy *m_scene = nullptr;
+    int m_shapes = 0;
+    bool m_committed = false;
+};
+
+#endif // INTERSECTOR_H__
@@ -0,0 +1,56 @@
+#pragma once
+#include <core/bitmap.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * \brief MIP pyramid over a Bitmap with trilinear and EWA lookups
+ *
+ * Level 0 is the bitmap itself (moved in, not copied). Every further level
+ * halves the resolution (rounding up, down to 1x1) with a tent filter of
+ * one destination texel radius, centered on the corner-aligned texel
+ * positions used by Bitmap::eval: texel i of a w-wide level sits at
+ * u = i / (w - 1) and indices wrap with period w - 1. Levels are only
+ * built when a lookup first needs them (thread-safe), so untouched levels
+ * cost no memory; build() creates all of them up front. Levels
+ * keep the storage format and layout of level 0.
+ *
+ * Footprints are given in uv units, i.e. the same space as the lookup
+ * coordinates (ray differentials of the uv parameterization).
+ */
+struct MIPMap
+{
+    explicit MIPMap(Bitmap bitmap);
+    explicit MIPMap(const char *filename,
+                    Bitmap::StorageFormat format = Bitmap::StorageFormat::Full);
+
+    MIPMap(const MIPMap &) = delete;
+    MIPMap &operator=(const MIPMap &) = delete;
+
+    /// Build every level, each level is filtered in parallel
+    void build();
+    /// Level \c l, built on first access
+    const Bitmap &level(int l) const;
+    int levels() const { return static_cast<int>(m_levels.size()); }
+
+    /// Isotropic lookup, \c width is the footprint diameter in uv units
+    Spectrum evalTrilinear(const Vector2 &uv, Float width, bool flip_v = true) const;
+    /**
+     * Elliptically weighted average (Heckbert 1989) over the ellipse with
+     * axes \c duvdx and \c duvdy, blended across the two nearest levels.
+     * Ellipses more eccentric than \c max_anisotropy are widened.
+     */
+    Spectrum evalEWA(const Vector2 &uv, const Vector2 &duvdx, const Vector2 &duvdy,
+                     bool flip_v = true, Float max_anisotropy = 8) const;
+
+    std::string toString() const;
+
+private:
+    void init();
+    Spectrum ewa(int l, Array2 uv, Vector2 axis0, Vector2 axis1) const;
+
+    mutable std::vector<Bitmap> m_levels;
+    std::unique_ptr<std::once_flag[]> m_built;
+};
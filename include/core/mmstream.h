@@ -0,0 +1,49 @@
+#pragma once
+
+#include <core/fstream.h>
+
+/**
+ * \brief Stream over a memory-mapped file
+ *
+ * Reads and writes are plain memcpy's from / into the mapping and data()
+ * gives direct access to the bytes. In the writable modes the mapping is
+ * shared with the file and grows (geometrically) when writing past its
+ * end; close() trims the file to the bytes actually written.
+ */
+struct MemoryMappedStream : public Stream {
+    MemoryMappedStream(const fs::path &p, FileStream::EMode mode = FileStream::ERead);
+    virtual ~MemoryMappedStream();
+
+    virtual void close() override;
+
+    using Stream::read;
+    using Stream::write;
+
+    virtual void read(void *p, size_t size) override;
+    virtual void write(const void *p, size_t size) override;
+    virtual void seek(size_t pos) override;
+    virtual size_t tell() const override { return m_pos; }
+    virtual size_t size() const override { return m_size; }
+    /// Schedules the dirty pages for writing (msync with MS_ASYNC)
+    virtual void flush() override;
+    virtual bool can_read() const override { return true; }
+    virtual bool can_write() const override { return m_mode != FileStream::ERead; }
+
+    /// The mapped bytes, size() of them are valid
+    uint8_t *data() { return m_data; }
+    const uint8_t *data() const { return m_data; }
+
+    std::string type_name() const override { return "MemoryMappedStream"; }
+
+private:
+    /// Grow the file and the mapping to at least \c size bytes
+    void reserve(size_t size);
+
+    FileStream::EMode m_mode;
+    fs::path          m_path;
+    int               m_fd       = -1;
+    uint8_t          *m_data     = nullptr;
+    size_t            m_size     = 0; // logical size
+    size_t            m_capacity = 0; // mapped size
+    size_t            m_pos      = 0;
+};
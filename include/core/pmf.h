@@ -3,10 +3,16 @@
 #define PMF_H__
 
 #include <core/fwd.h>
+#include <core/simd.h>
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 class DiscreteDistribution {
 public:
+    /// Entries per block of the parallel prefix sum in \ref rebuild()
+    static constexpr size_t RebuildBlock = 1 << 14;
+
     /// Allocate memory for a distribution with the given number of entries
     explicit inline DiscreteDistribution(size_t nEntries = 0) {
         reserve(nEntries);
@@ -15,12 +21,20 @@ public:
 
     inline DiscreteDistribution(const DiscreteDistribution &distrb)
         : m_cdf(distrb.m_cdf), m_sum(distrb.m_sum), m_normalization(distrb.m_normalization)
-        , m_normalized(distrb.m_normalized)
+        , m_normalized(distrb.m_normalized), m_useAlias(distrb.m_useAlias)
+        , m_alias(distrb.m_alias)
     {}
 
-    inline DiscreteDistribution(const ArrayXd &pmf) {
+    /**
+     * \brief Build a normalized distribution from a list of weights
+     *
+     * \param useAlias
+     *     Sample through a Walker/Vose alias table (see \ref setAliasSampling())
+     */
+    inline DiscreteDistribution(const ArrayXd &pmf, bool useAlias = false)
+        : m_useAlias(useAlias) {
         reserve(pmf.size());
-        m_cdf.clear();
+        clear();
         for (size_t i = 0; i < pmf.size(); ++i)
             append(pmf[i]);
         normalize();
@@ -30,6 +44,7 @@ public:
     inline void clear() {
         m_cdf.clear();
         m_cdf.push_back(0.0f);
+        m_alias.clear();
         m_sum = m_normalization = 0.0f;
         m_normalized = false;
     }
@@ -59,6 +74,28 @@ public:
         return m_normalized;
     }
 
+    /**
+     * \brief Select between CDF inversion and alias-table sampling
+     *
+     * When enabled, \ref normalize() additionally builds a Walker/Vose
+     * alias table and \ref sample() / \ref sampleReuse() run in constant
+     * time. The mapping from sample values to indices differs from CDF
+     * inversion (and is not monotonic), but the sampled distribution and
+     * \ref pmf() are identical.
+     */
+    inline void setAliasSampling(bool useAlias) {
+        m_useAlias = useAlias;
+        if (!m_useAlias)
+            m_alias.clear();
+        else if (m_normalized)
+            buildAliasTable();
+    }
+
+    /// Is the alias table used for sampling?
+    inline bool isAliasSampling() const {
+        return m_useAlias;
+    }
+
     /**
      * \brief Return the original (unnormalized) sum of all PDF entries
      *
@@ -90,16 +127,66 @@ public:
         m_sum = m_cdf[m_cdf.size()-1];
         if (m_sum > 0) {
             m_normalization = 1.0f / m_sum;
-            for (size_t i=1; i<m_cdf.size(); ++i)
+            const ptrdiff_t size = m_cdf.size();
+#pragma omp parallel for if (size > (1 << 16))
+            for (ptrdiff_t i=1; i<size; ++i)
                 m_cdf[i] *= m_normalization;
             m_cdf[m_cdf.size()-1] = 1.0f;
             m_normalized = true;
+            if (m_useAlias)
+                buildAliasTable();
         } else {
             m_normalization = 0.0f;
         }
         return m_sum;
     }
 
+    /**
+     * \brief Replace all entries by <tt>weight(i)</tt>, i = 0, ..., n-1, and
+     * normalize the distribution
+     *
+     * Equivalent to \ref clear(), \ref append() for every entry and
+     * \ref normalize(), but the existing CDF storage is reused. The entries
+     * are prefix-summed in blocks of RebuildBlock (in parallel with OpenMP),
+     * then the block offsets are added, so \c weight must be safe to call
+     * concurrently. The result does not depend on the thread count.
+     *
+     * \return Sum of the (unnormalized) entries
+     */
+    template <typename WeightFunc>
+    inline Float rebuild(size_t n, WeightFunc weight) {
+        assert(n > 0);
+        m_cdf.resize(n + 1);
+        m_cdf[0] = 0.0f;
+        m_alias.clear();
+        m_normalized = false;
+        Float *cdf = m_cdf.data() + 1;
+
+        // Fixed-size blocks, so the summation order (and the CDF rounding)
+        // does not depend on the number of threads
+        const ptrdiff_t blocks = static_cast<ptrdiff_t>((n + RebuildBlock - 1) / RebuildBlock);
+        std::vector<Float> offset(blocks + 1, 0.0f);
+#pragma omp parallel for if (blocks > 1)
+        for (ptrdiff_t b = 0; b < blocks; ++b) {
+            const size_t begin = b * RebuildBlock, end = std::min(begin + RebuildBlock, n);
+            Float sum = 0.0f;
+            for (size_t i = begin; i < end; ++i) {
+                sum += weight(i);
+                cdf[i] = sum;
+            }
+            offset[b + 1] = sum;
+        }
+        for (ptrdiff_t b = 1; b <= blocks; ++b)
+            offset[b] += offset[b - 1];
+#pragma omp parallel for if (blocks > 1)
+        for (ptrdiff_t b = 1; b < blocks; ++b) {
+            const size_t begin = b * RebuildBlock, end = std::min(begin + RebuildBlock, n);
+            for (size_t i = begin; i < end; ++i)
+                cdf[i] += offset[b];
+        }
+        return normalize();
+    }
+
     /**
      * \brief %Transform a uniformly distributed sample to the stored distribution
      *
@@ -109,17 +196,11 @@ public:
      *     The discrete index associated with the sample
      */
     inline size_t sample(Float sampleValue) const {
-        std::vector<Float>::const_iterator entry =
-                std::lower_bound(m_cdf.begin(), m_cdf.end(), sampleValue);
-        size_t index = std::min(m_cdf.size()-2,
-            (size_t) std::max((ptrdiff_t) 0, entry - m_cdf.begin() - 1));
-
-        /* Handle a rare corner-case where a entry has probability 0
-           but is sampled nonetheless */
-        while (operator[](index) == 0 && index < m_cdf.size()-1)
-            ++index;
-
-        return index;
+        if (!m_alias.empty()) {
+            Float u;
+            return sampleAlias(sampleValue, u);
+        }
+        return sampleCDF(sampleValue);
     }
 
     /**
@@ -149,6 +230,9 @@ public:
      *     The discrete index associated with the sample
      */
     inline size_t sampleReuse(Float &sampleValue) const {
+        if (!m_alias.empty())
+            return sampleAlias(sampleValue, sampleValue);
+
         size_t index = sample(sampleValue);
         sampleValue = (sampleValue - m_cdf[index])
             / (m_cdf[index + 1] - m_cdf[index]);
@@ -168,12 +252,77 @@ public:
      *     The discrete index associated with the sample
      */
     inline size_t sampleReuse(Float &sampleValue, Float &pdf) const {
+        if (!m_alias.empty()) {
+            size_t index = sampleAlias(sampleValue, sampleValue);
+            pdf = operator[](index);
+            return index;
+        }
+
         size_t index = sample(sampleValue, pdf);
         sampleValue = (sampleValue - m_cdf[index])
             / (m_cdf[index + 1] - m_cdf[index]);
         return index;
     }
 
+    /**
+     * \brief Batched version of \ref sample(Float, Float &)
+     *
+     * Maps \c count uniform samples to indices (and, if \c pdfs is not
+     * null, their probabilities). The result is identical to calling the
+     * scalar version on every sample, but the CDF searches of several
+     * samples are interleaved (see \ref simd::lowerBound()).
+     */
+    inline void sampleBatch(const Float *sampleValues, size_t count,
+                            uint32_t *indices, Float *pdfs = nullptr) const {
+        if (!m_alias.empty()) {
+            for (size_t i = 0; i < count; ++i) {
+                Float u;
+                indices[i] = static_cast<uint32_t>(sampleAlias(sampleValues[i], u));
+            }
+        } else {
+            assert(m_cdf.size() < (size_t) std::numeric_limits<int32_t>::max());
+            uint32_t first[simd::BatchChunk], len[simd::BatchChunk];
+            std::fill_n(first, simd::BatchChunk, 0);
+            std::fill_n(len, simd::BatchChunk, static_cast<uint32_t>(m_cdf.size()));
+            for (size_t i = 0; i < count; i += simd::BatchChunk) {
+                size_t n = std::min(simd::BatchChunk, count - i);
+                simd::lowerBound(m_cdf.data(), first, len, sampleValues + i, n,
+                                 indices + i);
+                for (size_t j = i; j < i + n; ++j)
+                    indices[j] = static_cast<uint32_t>(clampIndex(indices[j]));
+            }
+        }
+        if (pdfs) {
+            for (size_t i = 0; i < count; ++i)
+                pdfs[i] = operator[](indices[i]);
+        }
+    }
+
+    /**
+     * \brief Batched version of \ref sampleReuse(Float &, Float &)
+     *
+     * The samples are adjusted in place so that they can be reused.
+     */
+    inline void sampleReuseBatch(Float *sampleValues, size_t count,
+                                 uint32_t *indices, Float *pdfs = nullptr) const {
+        if (!m_alias.empty()) {
+            for (size_t i = 0; i < count; ++i)
+                indices[i] = static_cast<uint32_t>(
+                    sampleAlias(sampleValues[i], sampleValues[i]));
+            if (pdfs) {
+                for (size_t i = 0; i < count; ++i)
+                    pdfs[i] = operator[](indices[i]);
+            }
+            return;
+        }
+        sampleBatch(sampleValues, count, indices, pdfs);
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t index = indices[i];
+            sampleValues[i] = (sampleValues[i] - m_cdf[index])
+                / (m_cdf[index + 1] - m_cdf[index]);
+        }
+    }
+
     inline Float pmf(size_t index) const {
         return operator[](index);
     }
@@ -185,7 +334,7 @@ public:
     std::string toString() const {
         std::ostringstream oss;
         oss << "DiscreteDistribution[sum=" << m_sum << ", normalized="
-            << (int) m_normalized << ", cdf={";
+            << (int) m_normalized << ", alias=" << (int) m_useAlias << ", cdf={";
         for (size_t i=0; i<m_cdf.size(); ++i) {
             oss << m_cdf[i];
             if (i != m_cdf.size()-1)
@@ -195,10 +344,251 @@ public:
         return oss.str();
     }
 
+    /// One alias table bucket: keep the bucket's own index with probability \c prob
+    struct AliasEntry {
+        Float    prob;
+        uint32_t alias;
+    };
+
+protected:
+    /// Invert the CDF with a binary search
+    inline size_t sampleCDF(Float sampleValue) const {
+        std::vector<Float>::const_iterator entry =
+                std::lower_bound(m_cdf.begin(), m_cdf.end(), sampleValue);
+        return clampIndex(entry - m_cdf.begin());
+    }
+
+    /// Turn the position returned by the CDF search into an entry index
+    inline size_t clampIndex(ptrdiff_t position) const {
+        size_t index = std::min(m_cdf.size()-2,
+            (size_t) std::max((ptrdiff_t) 0, position - 1));
+
+        /* Handle a rare corner-case where a entry has probability 0
+           but is sampled nonetheless */
+        while (operator[](index) == 0 && index < m_cdf.size()-1)
+            ++index;
+
+        return index;
+    }
+
+    /**
+     * \brief Draw an index from the alias table
+     *
+     * The integer part of <tt>sampleValue * size()</tt> selects a bucket and
+     * the fractional part chooses between the bucket and its alias. That
+     * fractional part is rescaled to [0,1) and returned in \c reused.
+     */
+    inline size_t sampleAlias(Float sampleValue, Float &reused) const {
+        const size_t n = m_alias.size();
+        Float  scaled = sampleValue * static_cast<Float>(n);
+        size_t bucket = std::min(static_cast<size_t>(std::max(scaled, (Float) 0)), n - 1);
+        Float  u      = std::min(scaled - static_cast<Float>(bucket),
+                                 1 - std::numeric_limits<Float>::epsilon());
+
+        const AliasEntry &entry = m_alias[bucket];
+        if (u < entry.prob) {
+            reused = u / entry.prob;
+            return bucket;
+        }
+        reused = (u - entry.prob) / (1 - entry.prob);
+        return entry.alias;
+    }
+
+    /// Build the alias table from the normalized CDF (Vose's method)
+    inline void buildAliasTable() {
+        const size_t n = size();
+        assert(n < std::numeric_limits<uint32_t>::max());
+        m_alias.resize(n);
+
+        std::vector<uint32_t> small, large;
+        small.reserve(n);
+        large.reserve(n);
+        std::vector<Float> scaled(n);
+        for (size_t i = 0; i < n; ++i) {
+            scaled[i] = operator[](i) * static_cast<Float>(n);
+            m_alias[i].alias = static_cast<uint32_t>(i);
+            if (scaled[i] < 1)
+                small.push_back(static_cast<uint32_t>(i));
+            else
+                large.push_back(static_cast<uint32_t>(i));
+        }
+
+        while (!small.empty() && !large.empty()) {
+            uint32_t s = small.back(), l = large.back();
+            small.pop_back();
+            m_alias[s].prob  = scaled[s];
+            m_alias[s].alias = l;
+            scaled[l] = (scaled[l] + scaled[s]) - 1;
+            if (scaled[l] < 1) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+
+        /* Whatever is left is (up to round-off) exactly one bucket wide.
+           Zero-probability entries must never be returned, so hand their
+           leftover mass to a neighbour with nonzero probability. */
+        for (uint32_t l : large)
+            m_alias[l].prob = 1;
+        for (uint32_t s : small) {
+            m_alias[s].prob = 1;
+            if (operator[](s) == 0) {
+                m_alias[s].prob  = 0;
+                m_alias[s].alias = static_cast<uint32_t>(sampleCDF(m_cdf[s]));
+            }
+        }
+    }
+
+public:
     std::vector<Float> m_cdf;
     Float m_sum, m_normalization;
     bool m_normalized;
+    bool m_useAlias = false;
+    std::vector<AliasEntry> m_alias;
 };
 
 
+/**
+ * \brief Discrete distribution with O(log n) weight updates
+ *
+ * Same sampling interface as \ref DiscreteDistribution, but backed by a
+ * binary sum tree (implicit segment tree) over the unnormalized weights, so
+ * that \ref update() of a single weight, \ref sample() and \ref pmf() are
+ * all O(log n) or better. Every update recomputes its ancestors from their
+ * children, hence round-off does not accumulate over many updates.
+ *
+ * Probabilities are always normalized by the current sum of all weights.
+ */
+class DynamicDiscreteDistribution {
+public:
+    /// Create a distribution with \c nEntries zero weights
+    explicit inline DynamicDiscreteDistribution(size_t nEntries = 0) {
+        resize(nEntries);
+    }
+
+    inline DynamicDiscreteDistribution(const ArrayXd &weights) {
+        assign(weights);
+    }
+
+    /// Resize the distribution, all weights are reset to zero
+    inline void resize(size_t nEntries) {
+        m_size   = nEntries;
+        m_leaves = 1;
+        while (m_leaves < nEntries)
+            m_leaves *= 2;
+        m_tree.assign(2 * m_leaves, 0.0f);
+    }
+
+    /// Replace all weights, O(n)
+    inline void assign(const ArrayXd &weights) {
+        resize(weights.size());
+        for (size_t i = 0; i < m_size; ++i)
+            m_tree[m_leaves + i] = weights[i];
+        for (size_t i = m_leaves - 1; i > 0; --i)
+            m_tree[i] = m_tree[2 * i] + m_tree[2 * i + 1];
+    }
+
+    /// Set the (unnormalized) weight of an entry, O(log n)
+    inline void update(size_t index, Float weight) {
+        assert(index < m_size && weight >= 0);
+        size_t node = m_leaves + index;
+        m_tree[node] = weight;
+        for (node /= 2; node > 0; node /= 2)
+            m_tree[node] = m_tree[2 * node] + m_tree[2 * node + 1];
+    }
+
+    /// Return the number of entries
+    inline size_t size() const {
+        return m_size;
+    }
+
+    /// Return the unnormalized weight of an entry
+    inline Float weight(size_t entry) const {
+        return m_tree[m_leaves + entry];
+    }
+
+    /// Access the normalized probability of an entry
+    inline Float operator[](size_t entry) const {
+        return weight(entry) / getSum();
+    }
+
+    inline Float pmf(size_t index) const {
+        return operator[](index);
+    }
+
+    /// Return the sum of all weights
+    inline Float getSum() const {
+        return m_tree[1];
+    }
+
+    /**
+     * \brief %Transform a uniformly distributed sample to the stored distribution
+     *
+     * \param[in] sampleValue
+     *     An uniformly distributed sample on [0,1]
+     * \return
+     *     The discrete index associated with the sample
+     */
+    inline size_t sample(Float sampleValue) const {
+        return sampleReuse(sampleValue);
+    }
+
+    /// Same as above, also returns the probability of the sample
+    inline size_t sample(Float sampleValue, Float &pdf) const {
+        size_t index = sampleReuse(sampleValue);
+        pdf = operator[](index);
+        return index;
+    }
+
+    /**
+     * \brief %Transform a uniformly distributed sample to the stored distribution
+     *
+     * The original sample is value adjusted so that it can be "reused".
+     * Entries with zero weight are never returned.
+     */
+    inline size_t sampleReuse(Float &sampleValue) const {
+        assert(m_size > 0 && getSum() > 0);
+        Float  rem  = std::max(sampleValue, (Float) 0) * getSum();
+        size_t node = 1;
+        while (node < m_leaves) {
+            Float left = m_tree[2 * node], right = m_tree[2 * node + 1];
+            node *= 2;
+            if (rem >= left && right > 0) {
+                rem -= left;
+                ++node;
+            }
+        }
+        sampleValue = std::min(rem / m_tree[node],
+                               1 - std::numeric_limits<Float>::epsilon());
+        return node - m_leaves;
+    }
+
+    /// Same as above, also returns the probability of the sample
+    inline size_t sampleReuse(Float &sampleValue, Float &pdf) const {
+        size_t index = sampleReuse(sampleValue);
+        pdf = operator[](index);
+        return index;
+    }
+
+    /**
+     * \brief Turn the underlying distribution into a
+     * human-readable string format
+     */
+    std::string toString() const {
+        std::ostringstream oss;
+        oss << "DynamicDiscreteDistribution[sum=" << getSum() << ", weights={";
+        for (size_t i=0; i<m_size; ++i) {
+            oss << weight(i);
+            if (i != m_size-1)
+                oss << ", ";
+        }
+        oss << "}]";
+        return oss.str();
+    }
+
+    /// Binary sum tree: node i has children 2i and 2i+1, leaves start at m_leaves
+    std::vector<Float> m_tree;
+    size_t m_size = 0, m_leaves = 1;
+};
+
 #endif //PMF_H__
@@ -0,0 +1,103 @@
+#pragma once
+#ifndef QMC_SAMPLER_H__
+#define QMC_SAMPLER_H__
+
+#include <cstdint>
+#include <core/fwd.h>
+
+/*
+ * Low-discrepancy samplers with the same next1D/2D/3D/4D/sampleRndSeries
+ * interface as RndSampler (no common virtual base, so that they can be
+ * used as template arguments inside differentiated code).
+ *
+ * Each sampler produces the dimensions of one sample: \c idx selects the
+ * decorrelated sequence (e.g. the pixel) and \c sample_index the sample
+ * within it. Every call of nextXD() consumes the next X dimensions.
+ */
+
+/**
+ * Owen-scrambled Sobol' sequence, padded in 4D patterns (Burley 2020,
+ * "Practical Hash-based Owen Scrambling"): dimensions 4k..4k+3 are the first
+ * four Sobol' dimensions with an independently scrambled and shuffled index.
+ */
+struct SobolSampler {
+    static constexpr int Dimensions = 4;
+
+    SobolSampler(uint64_t seed, int idx, uint32_t sample_index = 0);
+    /// Start sample \c sample_index of the sequence (back at dimension 0)
+    void set_sample_index(uint32_t sample_index);
+
+    void sampleRndSeries(Float* rnd_series, int N);
+    Array2 next2D();
+    Array3 next3D();
+    Array4 next4D();
+    /**
+     * Evaluates the full generator matrix product (one xor per set bit) of
+     * the shuffled sample index. Consecutive samples are not one Gray-code
+     * step apart after the shuffle, so only enumerate() is incremental.
+     */
+    Float next1D();
+    void save();
+    void restore();
+
+    /// Unscrambled point \c index of Sobol' dimension \c dim < Dimensions
+    static uint32_t sobol(uint32_t index, int dim);
+    /**
+     * Write the first \c count points of dimension \c dim in Gray-code order,
+     * i.e. point i is sobol(i ^ (i >> 1), dim); each point costs one xor.
+     */
+    static void enumerate(int dim, uint32_t count, Float* out);
+
+    uint64_t m_seed;
+    uint32_t m_index;
+    uint32_t m_dim;
+    uint32_t m_saved_dim;
+};
+
+/// Halton sequence with a per-dimension Cranley-Patterson rotation
+struct HaltonSampler {
+    /// Number of prime bases, further dimensions fall back to hashing
+    static constexpr int Dimensions = 128;
+
+    HaltonSampler(uint64_t seed, int idx, uint32_t sample_index = 0);
+    void set_sample_index(uint32_t sample_index);
+
+    void sampleRndSeries(Float* rnd_series, int N);
+    Array2 next2D();
+    Array3 next3D();
+    Array4 next4D();
+    Float next1D();
+    void save();
+    void restore();
+
+    uint64_t m_seed;
+    uint32_t m_index;
+    uint32_t m_dim;
+    uint32_t m_saved_dim;
+};
+
+/**
+ * Jittered stratified sampler for \c spp samples per sequence. 1D requests
+ * use \c spp strata, 2D requests a ceil(sqrt(spp))^2 grid; every request is
+ * padded with its own random permutation of the strata.
+ */
+struct StratifiedSampler {
+    StratifiedSampler(uint64_t seed, int idx, uint32_t sample_index, uint32_t spp);
+    void set_sample_index(uint32_t sample_index);
+
+    void sampleRndSeries(Float* rnd_series, int N);
+    Array2 next2D();
+    Array3 next3D();
+    Array4 next4D();
+    Float next1D();
+    void save();
+    void restore();
+
+    uint64_t m_seed;
+    uint32_t m_index;
+    uint32_t m_spp;
+    uint32_t m_dim;
+    uint32_t m_saved_dim;
+};
+
+#endif
@@ -6,16 +6,36 @@
 #include <core/fwd.h>
 
 struct RndSampler {
+    /// Number of PCG steps that are computed side by side in bulk requests
+    static constexpr int Lanes = 8;
+
     RndSampler(uint64_t seed, int idx);
     uint32_t next_pcg32();
+    /// Same as N calls of next_pcg32(), but evaluated Lanes steps at a time
+    void next_pcg32(uint32_t *out, int N);
     void sampleRndSeries(Float* rnd_series, int N);
+#ifdef DOUBLE_PRECISION
+    /// Single precision samples (24 random bits each)
+    void sampleRndSeries(float* rnd_series, int N);
+#endif
     Array2 next2D();
     Array3 next3D();
     Array4 next4D();
     Float next1D();
+    /**
+     * Skip ahead (or back, for negative deltas cast to uint64_t) by \c delta
+     * calls of next_pcg32() in O(log delta) time, e.g. to position the
+     * stream at the first sample of a given pixel or to replay the random
+     * numbers of an earlier pass.
+     */
+    void advance(uint64_t delta);
+    /// Derive an independent stream; consumes four values of this one
+    RndSampler split();
+    /// Save / restore the full generator state (state and stream)
     void save();
     void restore();
     uint64_t saved;
+    uint64_t saved_inc;
     uint64_t state;
     uint64_t inc;
 };
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef SAMPLER_POOL_H__
+#define SAMPLER_POOL_H__
+
+#include <omp.h>
+
+#include <core/logger.h>
+#include <core/sampler.h>
+#include <vector>
+
+/**
+ * \brief Per-thread RndSampler storage for OpenMP loops
+ *
+ * Every OpenMP thread owns one slot, padded to a cache line so that
+ * advancing the samplers of neighbouring threads does not cause false
+ * sharing. All streams derive from one base stream: get() jumps a copy of
+ * it to the position of a work item with RndSampler::advance() (O(log idx))
+ * and splits the calling thread's sampler off there. The random numbers
+ * therefore only depend on (seed, work item) and not on the number of
+ * threads or the loop schedule:
+ *
+ *     SamplerPool pool(seed);
+ *     #pragma omp parallel for schedule(dynamic)
+ *     for (int i = 0; i < n; ++i) {
+ *         RndSampler &sampler = pool.get(i);
+ *         ...
+ *     }
+ */
+struct SamplerPool {
+    /// Values of the base stream consumed by RndSampler::split()
+    static constexpr uint64_t SplitStride = 4;
+
+    explicit SamplerPool(uint64_t seed, int nworker = omp_get_max_threads())
+        : m_base(seed, 0), m_slots(nworker) {}
+
+    /// Sampler of the calling thread, set to the stream of work item \c idx
+    RndSampler &get(int idx) {
+        PSDR_ASSERT(idx >= 0);
+        RndSampler parent = m_base;
+        parent.advance(SplitStride * (uint64_t) idx);
+        Slot &slot   = m_slots[thread_id()];
+        slot.sampler = parent.split();
+        return slot.sampler;
+    }
+
+    /// Sampler of the calling thread, in whatever state it was left
+    RndSampler &current() { return m_slots[thread_id()].sampler; }
+
+    int size() const { return static_cast<int>(m_slots.size()); }
+
+    struct alignas(64) Slot {
+        Slot() : sampler(0, 0) {}
+        RndSampler sampler;
+    };
+
+    RndSampler        m_base;
+    std::vector<Slot> m_slots;
+
+private:
+    int thread_id() const {
+        int tid = omp_get_thread_num();
+        PSDR_ASSERT_MSG(tid < size(), "SamplerPool: thread {} but only {} slots", tid, size());
+        return tid;
+    }
+};
+
+#endif
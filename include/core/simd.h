@@ -0,0 +1,111 @@
+#pragma once
+#ifndef SIMD_H__
+#define SIMD_H__
+
+#include <core/fwd.h>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace simd
+{
+    /// Number of samples processed per chunk by the batched routines
+    constexpr size_t BatchChunk = 256;
+
+    /**
+     * \brief Branch-free \c std::lower_bound on a single range
+     *
+     * Returns the offset (relative to \c data) of the first element in
+     * [data + first, data + first + count) that is not less than \c value,
+     * or first + count when there is none.
+     */
+    inline uint32_t lowerBound(const Float *data, uint32_t first,
+                               uint32_t count, Float value)
+    {
+        uint32_t base = first, len = count;
+        while (len > 1)
+        {
+            uint32_t half = len / 2;
+            base = (data[base + half] < value) ? base + half : base;
+            len -= half;
+        }
+        return base + (len > 0 && data[base] < value);
+    }
+
+    /**
+     * \brief Branch-free \c std::lower_bound over many sorted ranges at once
+     *
+     * Lane \c i searches [data + first[i], data + first[i] + count[i]) for
+     * value[i] and writes the same offset as the scalar version above to
+     * result[i]. All offsets must fit in a signed 32-bit integer.
+     *
+     * With AVX-512 (F + VL) eight lanes and with AVX2 four lanes are
+     * searched in lock step using gathers; remaining lanes and other
+     * targets use the scalar version.
+     */
+    inline void lowerBound(const Float *data, const uint32_t *first,
+                           const uint32_t *count, const Float *value,
+                           size_t n, uint32_t *result)
+    {
+        size_t i = 0;
+#if defined(DOUBLE_PRECISION) && defined(__AVX512F__) && defined(__AVX512VL__)
+        const __m256i one = _mm256_set1_epi32(1);
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i base = _mm256_loadu_si256((const __m256i *) (first + i));
+            __m256i len  = _mm256_loadu_si256((const __m256i *) (count + i));
+            __m512d v    = _mm512_loadu_pd(value + i);
+            __mmask8 active;
+            while ((active = _mm256_cmpgt_epi32_mask(len, one)))
+            {
+                __m256i  half = _mm256_srli_epi32(len, 1);
+                __m512d  vals = _mm512_mask_i32gather_pd(v, active, _mm256_add_epi32(base, half), data, 8);
+                __mmask8 lt   = _mm512_mask_cmp_pd_mask(active, vals, v, _CMP_LT_OQ);
+                base = _mm256_mask_add_epi32(base, lt, base, half);
+                len  = _mm256_sub_epi32(len, half);
+            }
+            __mmask8 nonempty = _mm256_cmpgt_epi32_mask(len, _mm256_setzero_si256());
+            __m512d  vals     = _mm512_mask_i32gather_pd(v, nonempty, base, data, 8);
+            __mmask8 lt       = _mm512_mask_cmp_pd_mask(nonempty, vals, v, _CMP_LT_OQ);
+            base = _mm256_mask_add_epi32(base, lt, base, one);
+            _mm256_storeu_si256((__m256i *) (result + i), base);
+        }
+#elif defined(DOUBLE_PRECISION) && defined(__AVX2__)
+        const __m128i one  = _mm_set1_epi32(1);
+        const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128i base = _mm_loadu_si128((const __m128i *) (first + i));
+            __m128i len  = _mm_loadu_si128((const __m128i *) (count + i));
+            __m256d v    = _mm256_loadu_pd(value + i);
+            __m128i active;
+            while (_mm_movemask_ps(_mm_castsi128_ps(active = _mm_cmpgt_epi32(len, one))))
+            {
+                // only lanes that are still searching may touch memory
+                __m128i half = _mm_srli_epi32(len, 1);
+                __m256d vals = _mm256_mask_i32gather_pd(
+                    v, data, _mm_add_epi32(base, half),
+                    _mm256_castsi256_pd(_mm256_cvtepi32_epi64(active)), 8);
+                // 64-bit comparison mask -> 32-bit lanes
+                __m128i lt = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+                    _mm256_castpd_si256(_mm256_cmp_pd(vals, v, _CMP_LT_OQ)), even));
+                base = _mm_add_epi32(base, _mm_and_si128(half, lt));
+                len  = _mm_sub_epi32(len, half);
+            }
+            __m128i nonempty = _mm_cmpgt_epi32(len, _mm_setzero_si128());
+            __m256d vals     = _mm256_mask_i32gather_pd(
+                v, data, base, _mm256_castsi256_pd(_mm256_cvtepi32_epi64(nonempty)), 8);
+            __m128i lt = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+                _mm256_castpd_si256(_mm256_cmp_pd(vals, v, _CMP_LT_OQ)), even));
+            base = _mm_sub_epi32(base, _mm_and_si128(lt, nonempty)); // lt lanes are -1
+            _mm_storeu_si128((__m128i *) (result + i), base);
+        }
+#endif
+        for (; i < n; ++i)
+            result[i] = lowerBound(data, first[i], count[i], value[i]);
+    }
+} // namespace simd
+
+#endif // SIMD_H__
@@ -1,6 +1,9 @@
 #pragma once
 #include <core/logger.h>
 #include <core/object.h>
+
+#include <algorithm>
+#include <cstring>
 // =============================================================================
 //                                  Helper Functions
 // =============================================================================
@@ -9,19 +12,43 @@ T swap(const T &v) {
     return v;
 }
 
+// The byte swaps go through the bit pattern (memcpy), so that floating
+// point values are swapped instead of converted to integers.
 template <typename T, std::enable_if_t<sizeof(T) == 2, int> = 0>
 T swap(const T &v) {
-    return __builtin_bswap16(static_cast<uint16_t>(v));
+    uint16_t bits;
+    memcpy(&bits, &v, sizeof(T));
+    bits = __builtin_bswap16(bits);
+    T ret;
+    memcpy(&ret, &bits, sizeof(T));
+    return ret;
 }
 
 template <typename T, std::enable_if_t<sizeof(T) == 4, int> = 0>
 T swap(const T &v) {
-    return __builtin_bswap32(static_cast<uint32_t>(v));
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(T));
+    bits = __builtin_bswap32(bits);
+    T ret;
+    memcpy(&ret, &bits, sizeof(T));
+    return ret;
 }
 
 template <typename T, std::enable_if_t<sizeof(T) == 8, int> = 0>
 T swap(const T &v) {
-    return __builtin_bswap64(static_cast<uint64_t>(v));
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(T));
+    bits = __builtin_bswap64(bits);
+    T ret;
+    memcpy(&ret, &bits, sizeof(T));
+    return ret;
+}
+
+/// Swap the bytes of \c count values in place (a tight loop the compiler vectorizes)
+template <typename T>
+void swap_array(T *value, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        value[i] = swap(value[i]);
 }
 
 struct Stream : public Object {
@@ -32,7 +59,20 @@ struct Stream : public Object {
 
     virtual void close() = 0;
 
+    /// Read \c size bytes, throws when fewer are available
     virtual void read(void *p, size_t size) = 0;
+    /// Write \c size bytes at the current position
+    virtual void write(const void *p, size_t size) = 0;
+    /// Move the current position to byte \c pos
+    virtual void seek(size_t pos) = 0;
+    /// Current position
+    virtual size_t tell() const = 0;
+    /// Size of the underlying data in bytes
+    virtual size_t size() const = 0;
+    /// Push buffered writes to the underlying storage
+    virtual void flush() = 0;
+    virtual bool can_read() const = 0;
+    virtual bool can_write() const = 0;
 
     template <typename T>
     void read(T &value) {
@@ -49,15 +89,45 @@ struct Stream : public Object {
         return value;
     }
 
+    /// Read \c count values with a single call to read(), then swap them in bulk
     template <typename T>
     void read_array(T *value, size_t count) {
         read(value, sizeof(T) * count);
+        if (needs_endianness_swap())
+            swap_array(value, count);
+    }
+
+    template <typename T>
+    void write(const T &value) {
         if (needs_endianness_swap()) {
-            for (size_t i = 0; i < count; ++i)
-                value[i] = swap(value[i]);
+            T swapped = swap(value);
+            write(&swapped, sizeof(T));
+        } else {
+            write(&value, sizeof(T));
         }
     }
 
+    /// Write \c count values, swapped through a fixed-size staging buffer when needed
+    template <typename T>
+    void write_array(const T *value, size_t count) {
+        if (!needs_endianness_swap()) {
+            write(value, sizeof(T) * count);
+            return;
+        }
+        constexpr size_t Chunk = std::max<size_t>(4096 / sizeof(T), 1);
+        T tmp[Chunk];
+        for (size_t i = 0; i < count; i += Chunk) {
+            size_t n = std::min(Chunk, count - i);
+            std::copy(value + i, value + i + n, tmp);
+            swap_array(tmp, n);
+            write(tmp, sizeof(T) * n);
+        }
+    }
+
+    void set_byte_order(EByteOrder value) { m_byte_order = value; }
+    EByteOrder byte_order() const { return m_byte_order; }
+    static EByteOrder host_byte_order() { return m_host_byte_order; }
+
     /// Returns true if we need to perform endianness swapping before writing or
     /// reading.
     bool needs_endianness_swap() const {
@@ -0,0 +1,542 @@
+#pragma once
+#ifndef TRIANGLE_SIMD_H__
+#define TRIANGLE_SIMD_H__
+
+#include <core/aabb_simd.h>
+
+namespace simd
+{
+    /// Rays with |det| below this are parallel to the triangle (same threshold as rayIntersectTriangle)
+    constexpr Float TriangleEpsilon = 1e-8f;
+
+    /// Lane count of the widest Moller-Trumbore kernel compiled in, a TriangleN of this size fills it
+#if defined(DOUBLE_PRECISION) && defined(__AVX512F__)
+    constexpr int NativeWidth = 8;
+#else
+    constexpr int NativeWidth = 4;
+#endif
+    /// Same for the single precision watertight kernel and TriangleNf
+#if defined(__AVX512F__)
+    constexpr int NativeWidthf = 16;
+#else
+    constexpr int NativeWidthf = 8;
+#endif
+
+    /**
+     * \brief \c N triangles in SoA layout, precomputed for Moller-Trumbore
+     *
+     * Stores the first vertex and both edges of each triangle along with a
+     * user index (-1 for unused lanes). Unused lanes have zero edges and
+     * are never hit.
+     */
+    template <int N>
+    struct TriangleN
+    {
+        static_assert(N > 0 && N <= 32, "TriangleN: at most 32 lanes");
+
+        TriangleN() { reset(); }
+
+        void reset()
+        {
+            for (int a = 0; a < 3; ++a)
+                for (int i = 0; i < N; ++i)
+                    p0[a][i] = e1[a][i] = e2[a][i] = 0;
+            for (int i = 0; i < N; ++i)
+                index[i] = -1;
+        }
+
+        void set(int i, const Vector &v0, const Vector &v1, const Vector &v2, int idx)
+        {
+            for (int a = 0; a < 3; ++a) {
+                p0[a][i] = v0[a];
+                e1[a][i] = v1[a] - v0[a];
+                e2[a][i] = v2[a] - v0[a];
+            }
+            index[i] = idx;
+        }
+
+        alignas(64) Float p0[3][N];
+        alignas(64) Float e1[3][N];
+        alignas(64) Float e2[3][N];
+        int index[N];
+    };
+
+    namespace detail
+    {
+        /// Lane operations used by the Moller-Trumbore kernel, one struct per register width
+        struct Lanes1
+        {
+            static constexpr int Width = 1;
+            using V = Float;
+            using M = bool;
+            static V set1(Float x) { return x; }
+            static V load(const Float *p) { return *p; }
+            static void store(Float *p, V x) { *p = x; }
+            static V add(V a, V b) { return a + b; }
+            static V sub(V a, V b) { return a - b; }
+            static V mul(V a, V b) { return a * b; }
+            static V div(V a, V b) { return a / b; }
+            static M ge(V a, V b) { return a >= b; }
+            static M le(V a, V b) { return a <= b; }
+            static M and_(M a, M b) { return a && b; }
+            static M or_(M a, M b) { return a || b; }
+            static uint32_t bits(M m) { return m; }
+        };
+
+#if defined(DOUBLE_PRECISION) && defined(__AVX2__)
+        struct Lanes4
+        {
+            static constexpr int Width = 4;
+            using V = __m256d;
+            using M = __m256d;
+            static V set1(Float x) { return _mm256_set1_pd(x); }
+            static V load(const Float *p) { return _mm256_loadu_pd(p); }
+            static void store(Float *p, V x) { _mm256_storeu_pd(p, x); }
+            static V add(V a, V b) { return _mm256_add_pd(a, b); }
+            static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+            static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+            static V div(V a, V b) { return _mm256_div_pd(a, b); }
+            static M ge(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+            static M le(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+            static M and_(M a, M b) { return _mm256_and_pd(a, b); }
+            static M or_(M a, M b) { return _mm256_or_pd(a, b); }
+            static uint32_t bits(M m) { return (uint32_t) _mm256_movemask_pd(m); }
+        };
+#endif
+
+#if defined(DOUBLE_PRECISION) && defined(__AVX512F__)
+        struct Lanes8
+        {
+            static constexpr int Width = 8;
+            using V = __m512d;
+            using M = __mmask8;
+            static V set1(Float x) { return _mm512_set1_pd(x); }
+            static V load(const Float *p) { return _mm512_loadu_pd(p); }
+            static void store(Float *p, V x) { _mm512_storeu_pd(p, x); }
+            static V add(V a, V b) { return _mm512_add_pd(a, b); }
+            static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+            static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+            static V div(V a, V b) { return _mm512_div_pd(a, b); }
+            static M ge(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+            static M le(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+            static M and_(M a, M b) { return (M) (a & b); }
+            static M or_(M a, M b) { return (M) (a | b); }
+            static uint32_t bits(M m) { return m; }
+        };
+#endif
+
+        /// Branch-free Moller-Trumbore on one register of lanes, returns the hit mask
+        template <typename L, typename V = typename L::V>
+        inline uint32_t mollerTrumbore(const V org[3], const V dir[3], const V p0[3], const V e1[3],
+                                       const V e2[3], V tmin, V tmax, V &u, V &v, V &t)
+        {
+            auto cross = [](const V a[3], const V b[3], V r[3]) {
+                r[0] = L::sub(L::mul(a[1], b[2]), L::mul(a[2], b[1]));
+                r[1] = L::sub(L::mul(a[2], b[0]), L::mul(a[0], b[2]));
+                r[2] = L::sub(L::mul(a[0], b[1]), L::mul(a[1], b[0]));
+            };
+            auto dot = [](const V a[3], const V b[3]) {
+                return L::add(L::add(L::mul(a[0], b[0]), L::mul(a[1], b[1])), L::mul(a[2], b[2]));
+            };
+
+            V pvec[3], qvec[3], s[3];
+            cross(dir, e2, pvec);
+            V det = dot(e1, pvec);
+            V inv_det = L::div(L::set1(1), det);
+            for (int a = 0; a < 3; ++a)
+                s[a] = L::sub(org[a], p0[a]);
+            u = L::mul(dot(s, pvec), inv_det);
+            cross(s, e1, qvec);
+            v = L::mul(dot(dir, qvec), inv_det);
+            t = L::mul(dot(e2, qvec), inv_det);
+
+            const V zero = L::set1(0), one = L::set1(1);
+            auto mask = L::or_(L::ge(det, L::set1(TriangleEpsilon)), L::le(det, L::set1(-TriangleEpsilon)));
+            mask = L::and_(mask, L::and_(L::ge(u, zero), L::ge(v, zero)));
+            mask = L::and_(mask, L::and_(L::le(u, one), L::le(L::add(u, v), one)));
+            mask = L::and_(mask, L::and_(L::ge(t, tmin), L::le(t, tmax)));
+            return L::bits(mask);
+        }
+
+        template <typename L, int N>
+        inline void intersectLanes(const Ray &ray, const TriangleN<N> &tri, int &i, Float *u,
+                                   Float *v, Float *t, uint32_t &mask)
+        {
+            using V = typename L::V;
+            V org[3], dir[3];
+            for (int a = 0; a < 3; ++a) {
+                org[a] = L::set1(ray.org[a]);
+                dir[a] = L::set1(ray.dir[a]);
+            }
+            const V tmin = L::set1(ray.tmin), tmax = L::set1(ray.tmax);
+            for (; i + L::Width <= N; i += L::Width) {
+                V p0[3], e1[3], e2[3], uu, vv, tt;
+                for (int a = 0; a < 3; ++a) {
+                    p0[a] = L::load(tri.p0[a] + i);
+                    e1[a] = L::load(tri.e1[a] + i);
+                    e2[a] = L::load(tri.e2[a] + i);
+                }
+                mask |= mollerTrumbore<L>(org, dir, p0, e1, e2, tmin, tmax, uu, vv, tt) << i;
+                L::store(u + i, uu);
+                L::store(v + i, vv);
+                L::store(t + i, tt);
+            }
+        }
+
+        template <typename L, int N>
+        inline void intersectLanes(const RayN<N> &ray, const Vector &v0, const Vector &v1,
+                                   const Vector &v2, int &i, Float *u, Float *v, Float *t,
+                                   uint32_t &mask)
+        {
+            using V = typename L::V;
+            V p0[3], e1[3], e2[3];
+            for (int a = 0; a < 3; ++a) {
+                p0[a] = L::set1(v0[a]);
+                e1[a] = L::set1(v1[a] - v0[a]);
+                e2[a] = L::set1(v2[a] - v0[a]);
+            }
+            for (; i + L::Width <= N; i += L::Width) {
+                V org[3], dir[3], uu, vv, tt;
+                for (int a = 0; a < 3; ++a) {
+                    org[a] = L::load(ray.org[a] + i);
+                    dir[a] = L::load(ray.dir[a] + i);
+                }
+                mask |= mollerTrumbore<L>(org, dir, p0, e1, e2, L::load(ray.tmin + i),
+                                          L::load(ray.tmax + i), uu, vv, tt) << i;
+                L::store(u + i, uu);
+                L::store(v + i, vv);
+                L::store(t + i, tt);
+            }
+        }
+    } // namespace detail
+
+    /**
+     * \brief One ray against \c N triangles
+     *
+     * Returns a bit mask of the triangles hit within [ray.tmin, ray.tmax]
+     * and writes the barycentrics and distances of every lane to \c u,
+     * \c v and \c t (meaningless when missed). Same acceptance rules as
+     * rayIntersectTriangle, without its early outs; results agree with it
+     * up to rounding (one reciprocal instead of three divisions). Eight
+     * lanes per instruction with AVX-512, four with AVX2.
+     */
+    template <int N>
+    inline uint32_t rayIntersect(const Ray &ray, const TriangleN<N> &tri, Float *u, Float *v, Float *t)
+    {
+        uint32_t mask = 0;
+        int i = 0;
+#if defined(DOUBLE_PRECISION) && defined(__AVX512F__)
+        detail::intersectLanes<detail::Lanes8>(ray, tri, i, u, v, t, mask);
+#endif
+#if defined(DOUBLE_PRECISION) && defined(__AVX2__)
+        detail::intersectLanes<detail::Lanes4>(ray, tri, i, u, v, t, mask);
+#endif
+        detail::intersectLanes<detail::Lanes1>(ray, tri, i, u, v, t, mask);
+        return mask;
+    }
+
+    /// \c N rays against one triangle, same conventions as above
+    template <int N>
+    inline uint32_t rayIntersect(const RayN<N> &ray, const Vector &v0, const Vector &v1,
+                                 const Vector &v2, Float *u, Float *v, Float *t)
+    {
+        uint32_t mask = 0;
+        int i = 0;
+#if defined(DOUBLE_PRECISION) && defined(__AVX512F__)
+        detail::intersectLanes<detail::Lanes8>(ray, v0, v1, v2, i, u, v, t, mask);
+#endif
+#if defined(DOUBLE_PRECISION) && defined(__AVX2__)
+        detail::intersectLanes<detail::Lanes4>(ray, v0, v1, v2, i, u, v, t, mask);
+#endif
+        detail::intersectLanes<detail::Lanes1>(ray, v0, v1, v2, i, u, v, t, mask);
+        return mask;
+    }
+
+    /**
+     * \brief Ray prepared for the single precision watertight test
+     *
+     * Following Woop et al. 2013, the dominant axis of the direction
+     * becomes z and the ray is sheared onto +z, so that every triangle is
+     * tested in the same 2D frame. Distances are rounded outwards.
+     */
+    struct WatertightRay
+    {
+        WatertightRay(const Ray &ray)
+        {
+            Vector3f dir = ray.dir.cast<float>();
+            kz = 0;
+            for (int a = 1; a < 3; ++a)
+                if (std::abs(dir[a]) > std::abs(dir[kz]))
+                    kz = a;
+            kx = (kz + 1) % 3;
+            ky = (kx + 1) % 3;
+            // keep the winding when the dominant direction is negative
+            if (dir[kz] < 0)
+                std::swap(kx, ky);
+            Sx = dir[kx] / dir[kz];
+            Sy = dir[ky] / dir[kz];
+            Sz = 1.f / dir[kz];
+            org = ray.org.cast<float>();
+            tmin = std::nextafter((float) ray.tmin, -std::numeric_limits<float>::infinity());
+            tmax = std::nextafter((float) ray.tmax, std::numeric_limits<float>::infinity());
+        }
+
+        int kx, ky, kz;
+        float Sx, Sy, Sz;
+        Vector3f org;
+        float tmin, tmax;
+    };
+
+    /// \c N triangles in SoA layout, single precision vertices for the watertight test
+    template <int N>
+    struct TriangleNf
+    {
+        static_assert(N > 0 && N <= 32, "TriangleNf: at most 32 lanes");
+
+        TriangleNf() { reset(); }
+
+        /// Unused lanes hold NaNs, which fail every comparison of the test
+        void reset()
+        {
+            for (int a = 0; a < 3; ++a)
+                for (int i = 0; i < N; ++i)
+                    v0[a][i] = v1[a][i] = v2[a][i] = std::numeric_limits<float>::quiet_NaN();
+            for (int i = 0; i < N; ++i)
+                index[i] = -1;
+        }
+
+        void set(int i, const Vector &p0, const Vector &p1, const Vector &p2, int idx)
+        {
+            for (int a = 0; a < 3; ++a) {
+                v0[a][i] = (float) p0[a];
+                v1[a][i] = (float) p1[a];
+                v2[a][i] = (float) p2[a];
+            }
+            index[i] = idx;
+        }
+
+        alignas(64) float v0[3][N];
+        alignas(64) float v1[3][N];
+        alignas(64) float v2[3][N];
+        int index[N];
+    };
+
+    namespace detail
+    {
+        /// Single precision lane operations used by the watertight kernel
+        struct Lanes1f
+        {
+            static constexpr int Width = 1;
+            using V = float;
+            using M = bool;
+            static V set1(float x) { return x; }
+            static V load(const float *p) { return *p; }
+            static void store(float *p, V x) { *p = x; }
+            static V add(V a, V b) { return a + b; }
+            static V sub(V a, V b) { return a - b; }
+            static V mul(V a, V b) { return a * b; }
+            static V div(V a, V b) { return a / b; }
+            static V abs(V a) { return std::abs(a); }
+            /// \c a with its sign flipped where \c s is negative
+            static V xorsign(V a, V s) { return std::signbit(s) ? -a : a; }
+            static M lt(V a, V b) { return a < b; }
+            static M gt(V a, V b) { return a > b; }
+            static M eq(V a, V b) { return a == b; }
+            static M ge(V a, V b) { return a >= b; }
+            static M le(V a, V b) { return a <= b; }
+            static M and_(M a, M b) { return a && b; }
+            static M or_(M a, M b) { return a || b; }
+            static M andnot(M a, M b) { return !a && b; }
+            static uint32_t bits(M m) { return m; }
+        };
+
+#if defined(__AVX2__)
+        struct Lanes8f
+        {
+            static constexpr int Width = 8;
+            using V = __m256;
+            using M = __m256;
+            static V set1(float x) { return _mm256_set1_ps(x); }
+            static V load(const float *p) { return _mm256_loadu_ps(p); }
+            static void store(float *p, V x) { _mm256_storeu_ps(p, x); }
+            static V add(V a, V b) { return _mm256_add_ps(a, b); }
+            static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+            static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+            static V div(V a, V b) { return _mm256_div_ps(a, b); }
+            static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+            static V xorsign(V a, V s) { return _mm256_xor_ps(a, _mm256_and_ps(s, _mm256_set1_ps(-0.f))); }
+            static M lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+            static M gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+            static M eq(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+            static M ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+            static M le(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+            static M and_(M a, M b) { return _mm256_and_ps(a, b); }
+            static M or_(M a, M b) { return _mm256_or_ps(a, b); }
+            static M andnot(M a, M b) { return _mm256_andnot_ps(a, b); }
+            static uint32_t bits(M m) { return (uint32_t) _mm256_movemask_ps(m); }
+        };
+#endif
+
+#if defined(__AVX512F__)
+        struct Lanes16f
+        {
+            static constexpr int Width = 16;
+            using V = __m512;
+            using M = __mmask16;
+            static V set1(float x) { return _mm512_set1_ps(x); }
+            static V load(const float *p) { return _mm512_loadu_ps(p); }
+            static void store(float *p, V x) { _mm512_storeu_ps(p, x); }
+            static V add(V a, V b) { return _mm512_add_ps(a, b); }
+            static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+            static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+            static V div(V a, V b) { return _mm512_div_ps(a, b); }
+            static V abs(V a) { return _mm512_abs_ps(a); }
+            static V xorsign(V a, V s)
+            {
+                const __m512i sign = _mm512_set1_epi32((int) 0x80000000u);
+                return _mm512_castsi512_ps(_mm512_xor_si512(
+                    _mm512_castps_si512(a), _mm512_and_si512(_mm512_castps_si512(s), sign)));
+            }
+            static M lt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+            static M gt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+            static M eq(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+            static M ge(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+            static M le(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+            static M and_(M a, M b) { return (M) (a & b); }
+            static M or_(M a, M b) { return (M) (a | b); }
+            static M andnot(M a, M b) { return (M) (~a & b); }
+            static uint32_t bits(M m) { return m; }
+        };
+#endif
+
+        /**
+         * Watertight test of one lane with the 2D edge functions in double
+         * precision, from the sheared vertices \c x, \c y and \c z of the
+         * vector path. Used for the rare lanes where a single precision edge
+         * function is too close to zero for its sign to be trusted (ray
+         * through an edge or a vertex).
+         */
+        inline bool watertightLane(const WatertightRay &ray, const float x[3], const float y[3],
+                                   const float z[3], float &u, float &v, float &t)
+        {
+            // products of floats are exact in double
+            double E0 = (double) x[2] * y[1] - (double) y[2] * x[1];
+            double E1 = (double) x[0] * y[2] - (double) y[0] * x[2];
+            double E2 = (double) x[1] * y[0] - (double) y[1] * x[0];
+            if ((E0 < 0 || E1 < 0 || E2 < 0) && (E0 > 0 || E1 > 0 || E2 > 0))
+                return false;
+            double det = E0 + E1 + E2;
+            if (det == 0)
+                return false;
+            double T = E0 * z[0] + E1 * z[1] + E2 * z[2];
+            if (det < 0 ? (T > ray.tmin * det || T < ray.tmax * det) : (T < ray.tmin * det || T > ray.tmax * det))
+                return false;
+            u = (float) (E1 / det);
+            v = (float) (E2 / det);
+            t = (float) (T / det);
+            return true;
+        }
+
+        template <typename L, int N>
+        inline void watertightLanes(const WatertightRay &ray, const TriangleNf<N> &tri, int &i,
+                                    float *u, float *v, float *t, uint32_t &mask)
+        {
+            using V = typename L::V;
+            const V Sx = L::set1(ray.Sx), Sy = L::set1(ray.Sy), Sz = L::set1(ray.Sz);
+            const V ox = L::set1(ray.org[ray.kx]), oy = L::set1(ray.org[ray.ky]), oz = L::set1(ray.org[ray.kz]);
+            const V zero = L::set1(0), tmin = L::set1(ray.tmin), tmax = L::set1(ray.tmax);
+            const V eps = L::set1(2 * std::numeric_limits<float>::epsilon());
+            const float *src[3][3] = {
+                { tri.v0[ray.kx], tri.v0[ray.ky], tri.v0[ray.kz] },
+                { tri.v1[ray.kx], tri.v1[ray.ky], tri.v1[ray.kz] },
+                { tri.v2[ray.kx], tri.v2[ray.ky], tri.v2[ray.kz] },
+            };
+            for (; i + L::Width <= N; i += L::Width) {
+                // vertices relative to the origin, sheared onto the ray frame
+                V x[3], y[3], z[3];
+                for (int k = 0; k < 3; ++k) {
+                    V dz = L::sub(L::load(src[k][2] + i), oz);
+                    x[k] = L::sub(L::sub(L::load(src[k][0] + i), ox), L::mul(Sx, dz));
+                    y[k] = L::sub(L::sub(L::load(src[k][1] + i), oy), L::mul(Sy, dz));
+                    z[k] = L::mul(Sz, dz);
+                }
+                // 2D edge functions, opposite to the first, second and third vertex. Their
+                // sign is exact unless |E| is within the rounding error of the two products
+                // (with or without FMA contraction), those lanes are redone in double
+                V E[3], uncertain[3];
+                for (int k = 0; k < 3; ++k) {
+                    const int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+                    V p = L::mul(x[k2], y[k1]), q = L::mul(y[k2], x[k1]);
+                    E[k] = L::sub(p, q);
+                    uncertain[k] = L::mul(L::add(L::abs(p), L::abs(q)), eps);
+                }
+                V E0 = E[0], E1 = E[1], E2 = E[2];
+                auto negative = L::or_(L::or_(L::lt(E0, zero), L::lt(E1, zero)), L::lt(E2, zero));
+                auto positive = L::or_(L::or_(L::gt(E0, zero), L::gt(E1, zero)), L::gt(E2, zero));
+                V det = L::add(L::add(E0, E1), E2);
+                V T = L::add(L::add(L::mul(E0, z[0]), L::mul(E1, z[1])), L::mul(E2, z[2]));
+                // compare T / det against [tmin, tmax] without dividing
+                V Ts = L::xorsign(T, det), det_abs = L::abs(det);
+                auto valid = L::andnot(L::and_(negative, positive), L::gt(det_abs, zero));
+                valid = L::and_(valid, L::and_(L::ge(Ts, L::mul(tmin, det_abs)), L::le(Ts, L::mul(tmax, det_abs))));
+
+                V rcp = L::div(L::set1(1), det);
+                L::store(u + i, L::mul(E1, rcp));
+                L::store(v + i, L::mul(E2, rcp));
+                L::store(t + i, L::mul(T, rcp));
+
+                uint32_t lanes = L::bits(valid);
+                uint32_t degenerate = L::bits(L::or_(L::or_(L::le(L::abs(E0), uncertain[0]),
+                                                            L::le(L::abs(E1), uncertain[1])),
+                                                     L::le(L::abs(E2), uncertain[2])));
+                if (degenerate) {
+                    float xs[3][L::Width], ys[3][L::Width], zs[3][L::Width];
+                    for (int k = 0; k < 3; ++k) {
+                        L::store(xs[k], x[k]);
+                        L::store(ys[k], y[k]);
+                        L::store(zs[k], z[k]);
+                    }
+                    for (; degenerate; degenerate &= degenerate - 1) {
+                        const int j = __builtin_ctz(degenerate);
+                        const float xj[3] = { xs[0][j], xs[1][j], xs[2][j] }, yj[3] = { ys[0][j], ys[1][j], ys[2][j] },
+                                    zj[3] = { zs[0][j], zs[1][j], zs[2][j] };
+                        lanes &= ~(1u << j);
+                        if (watertightLane(ray, xj, yj, zj, u[i + j], v[i + j], t[i + j]))
+                            lanes |= 1u << j;
+                    }
+                }
+                mask |= lanes << i;
+            }
+        }
+    } // namespace detail
+
+    /**
+     * \brief Watertight single precision test of one ray against \c N triangles
+     *
+     * Woop, Benthin and Wald 2013: no ray passes between two triangles that
+     * share an edge, and a ray through the shared edge hits at least one of
+     * them. Edge functions whose sign is uncertain in single precision are
+     * redone in double.
+     * Returns the hit mask within [ray.tmin, ray.tmax] and writes
+     * barycentrics (weights of the second and third vertex, as in
+     * rayIntersectTriangle) and distances of every lane. Sixteen lanes per
+     * instruction with AVX-512, eight with AVX2.
+     */
+    template <int N>
+    inline uint32_t rayIntersect(const WatertightRay &ray, const TriangleNf<N> &tri, float *u,
+                                 float *v, float *t)
+    {
+        uint32_t mask = 0;
+        int i = 0;
+#if defined(__AVX512F__)
+        detail::watertightLanes<detail::Lanes16f>(ray, tri, i, u, v, t, mask);
+#endif
+#if defined(__AVX2__)
+        detail::watertightLanes<detail::Lanes8f>(ray, tri, i, u, v, t, mask);
+#endif
+        detail::watertightLanes<detail::Lanes1f>(ray, tri, i, u, v, t, mask);
+        return mask;
+    }
+} // namespace simd
+
+#endif // TRIANGLE_SIMD_H__
@@ -126,6 +126,23 @@ namespace util
 }
 
 // IO Utils
+static_assert(sizeof(Spectrum) == 3 * sizeof(Float), "Spectrum must be three packed components");
+
+/// Flat view (r0, g0, b0, r1, ...) of the first \c n_pixels entries of a spectrum list, no copy
+inline Eigen::Map<Eigen::Array<Float, Eigen::Dynamic, 1>>
+spectrum_list_as_tensor(std::vector<Spectrum> &spec_list, int n_pixels)
+{
+    assert(n_pixels <= (int) spec_list.size());
+    return Eigen::Map<Eigen::Array<Float, Eigen::Dynamic, 1>>(spec_list.data()->data(), 3 * (Eigen::Index) n_pixels);
+}
+
+inline Eigen::Map<const Eigen::Array<Float, Eigen::Dynamic, 1>>
+spectrum_list_as_tensor(const std::vector<Spectrum> &spec_list, int n_pixels)
+{
+    assert(n_pixels <= (int) spec_list.size());
+    return Eigen::Map<const Eigen::Array<Float, Eigen::Dynamic, 1>>(spec_list.data()->data(), 3 * (Eigen::Index) n_pixels);
+}
+
 ArrayXd from_spectrum_list_to_tensor(const std::vector<Spectrum> &spec_list, int n_pixels);
 
 // template <class T>
@@ -133,6 +150,8 @@ ArrayXd from_spectrum_list_to_tensor(const std::vector<Spectrum> &spec_list, int
 //     ptr<float> p_image);
 
 std::vector<Spectrum> from_tensor_to_spectrum_list(const ArrayXd &arr, int n_pixels);
+/// Same as above, reusing the storage of \c spec_list
+void from_tensor_to_spectrum_list(const ArrayXd &arr, int n_pixels, std::vector<Spectrum> &spec_list);
 
 inline Float rgb2luminance(const Spectrum &rgb) {
         return rgb.x() * .2126f + rgb.y() * .7152f + rgb.z() * .0722f;
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <core/stream.h>
+#include <memory>
+
+/**
+ * \brief Transparent zlib (deflate) compression on top of another stream
+ *
+ * Data written to a ZStream is compressed into the child stream, data read
+ * from it is decompressed from the child stream, both incrementally through
+ * fixed-size buffers. Uses the bundled miniz.
+ *
+ * In the chunk-parallel mode, written data is cut into independent chunks
+ * that all OpenMP threads compress at once (as pigz does). Each chunk ends
+ * on a byte-aligned full flush, so the result is still a single ordinary
+ * zlib stream that the serial reader (or any zlib) decompresses. Matches
+ * cannot cross chunk boundaries (miniz has no preset dictionaries), so
+ * chunks should be large, on the order of 1 MB, to keep the ratio close
+ * to the serial one.
+ *
+ * The child stream is not owned and must outlive the ZStream. close()
+ * finishes the compressed stream but leaves the child open, so more data
+ * can follow it; a ZStream opened with EDeflate still emits a valid empty
+ * stream when nothing was written. Reading stops right behind the compressed data: input buffered
+ * past its end is handed back to the child (which must support seek()),
+ * at the latest when the ZStream is closed.
+ */
+struct ZStream : public Stream {
+    static constexpr int DefaultLevel = 6;
+
+    /// Direction of the stream
+    enum EMode {
+        /// Compress written data into the child
+        EDeflate = 0,
+        /// Decompress data read from the child
+        EInflate
+    };
+
+    /**
+     * \param child           Stream holding the compressed data
+     * \param mode            Whether to compress (write) or decompress (read)
+     * \param level           Compression level, 0 (store) to 9 (best)
+     * \param parallel_chunk  Chunk size in bytes of the chunk-parallel
+     *                        compression mode, 0 compresses serially
+     */
+    ZStream(Stream &child, EMode mode, int level = DefaultLevel, size_t parallel_chunk = 0);
+    virtual ~ZStream();
+
+    virtual void close() override;
+
+    using Stream::read;
+    using Stream::write;
+
+    virtual void read(void *p, size_t size) override;
+    virtual void write(const void *p, size_t size) override;
+    /// Unsupported, throws
+    virtual void seek(size_t pos) override;
+    /// Number of uncompressed bytes read or written so far
+    virtual size_t tell() const override;
+    /// Unsupported, throws
+    virtual size_t size() const override;
+    /// Emit everything written so far (serial mode: a sync flush, chunk mode: the pending batch) and flush the child
+    virtual void flush() override;
+    virtual bool can_read() const override { return m_mode == EInflate; }
+    virtual bool can_write() const override { return m_mode == EDeflate; }
+
+    Stream &child_stream() { return m_child; }
+
+    std::string type_name() const override { return "ZStream"; }
+
+private:
+    struct State;
+
+    void init_deflate();
+    void init_inflate();
+    void write_header();
+    void deflate_buffer(const void *p, size_t size, int flush);
+    void compress_batch(bool final);
+    bool refill();
+    void end_inflate();
+    void finish_inflate();
+
+    Stream                &m_child;
+    EMode                  m_mode;
+    std::unique_ptr<State> m_state;
+};
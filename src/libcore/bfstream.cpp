@@ -0,0 +1,155 @@
+#include <core/bfstream.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int open_flags(FileStream::EMode mode) {
+    switch (mode) {
+        case FileStream::ERead:
+            return O_RDONLY;
+        case FileStream::EReadWrite:
+            return O_RDWR;
+        case FileStream::ETruncReadWrite:
+            return O_RDWR | O_CREAT | O_TRUNC;
+        default:
+            Throw("Internal error");
+    }
+}
+
+BufferedFileStream::BufferedFileStream(const fs::path &p, FileStream::EMode mode,
+                                       size_t buffer_size)
+    : Stream(), m_mode(mode), m_path(p), m_buffer(std::max<size_t>(buffer_size, 1)) {
+    m_fd = ::open(p.c_str(), ::open_flags(mode), 0644);
+    if (m_fd < 0)
+        Throw("\"{}\": I/O error while attempting to open file: {}", m_path.string(),
+              strerror(errno));
+}
+
+BufferedFileStream::~BufferedFileStream() { close(); }
+
+void BufferedFileStream::close() {
+    if (m_fd < 0)
+        return;
+    flush_buffer();
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+void BufferedFileStream::read_at(void *p, size_t size, size_t offset, size_t requested) {
+    uint8_t *dst = static_cast<uint8_t *>(p);
+    size_t   done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(m_fd, dst + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            Throw("\"{}\": I/O error while attempting to read {} bytes: {}", m_path.string(),
+                  requested, strerror(errno));
+        if (n == 0)
+            Throw("\"{}\": read {} out of {} bytes", m_path.string(), done, requested);
+        done += n;
+    }
+}
+
+void BufferedFileStream::write_at(const void *p, size_t size, size_t offset) {
+    const uint8_t *src = static_cast<const uint8_t *>(p);
+    size_t         done = 0;
+    while (done < size) {
+        ssize_t n = ::pwrite(m_fd, src + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            Throw("\"{}\": I/O error while attempting to write {} bytes: {}", m_path.string(),
+                  size, strerror(errno));
+        done += n;
+    }
+}
+
+void BufferedFileStream::flush_buffer() {
+    if (m_dirty && m_offset > 0)
+        write_at(m_buffer.data(), m_offset, m_start);
+    m_start += m_offset;
+    m_offset = 0;
+    m_valid  = 0;
+    m_dirty  = false;
+}
+
+void BufferedFileStream::read(void *p, size_t size) {
+    if (m_dirty)
+        flush_buffer();
+    uint8_t *dst       = static_cast<uint8_t *>(p);
+    size_t   requested = size;
+
+    size_t n = std::min(size, m_valid - m_offset);
+    memcpy(dst, m_buffer.data() + m_offset, n);
+    m_offset += n;
+    dst += n;
+    size -= n;
+    if (size == 0)
+        return;
+
+    flush_buffer();
+    if (size >= m_buffer.size()) {
+        read_at(dst, size, m_start, requested);
+        m_start += size;
+        return;
+    }
+
+    // refill with whatever the file still has, up to a whole buffer
+    size_t  avail = 0;
+    while (avail < size) {
+        ssize_t r = ::pread(m_fd, m_buffer.data() + avail, m_buffer.size() - avail,
+                            m_start + avail);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            Throw("\"{}\": I/O error while attempting to read {} bytes: {}", m_path.string(),
+                  requested, strerror(errno));
+        if (r == 0)
+            Throw("\"{}\": read {} out of {} bytes", m_path.string(),
+                  requested - size + avail, requested);
+        avail += r;
+    }
+    m_valid = avail;
+    memcpy(dst, m_buffer.data(), size);
+    m_offset = size;
+}
+
+void BufferedFileStream::write(const void *p, size_t size) {
+    if (!can_write())
+        Throw("\"{}\": attempted to write to a read-only file", m_path.string());
+    if (!m_dirty)
+        flush_buffer(); // drop the read window
+    if (m_offset + size > m_buffer.size()) {
+        flush_buffer();
+        if (size >= m_buffer.size()) {
+            write_at(p, size, m_start);
+            m_start += size;
+            return;
+        }
+    }
+    memcpy(m_buffer.data() + m_offset, p, size);
+    m_offset += size;
+    m_dirty = true;
+}
+
+void BufferedFileStream::seek(size_t pos) {
+    if (!m_dirty && pos >= m_start && pos <= m_start + m_valid) {
+        m_offset = pos - m_start;
+        return;
+    }
+    flush_buffer();
+    m_start = pos;
+}
+
+size_t BufferedFileStream::size() const {
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+        Throw("\"{}\": I/O error while attempting to determine the file size: {}",
+              m_path.string(), strerror(errno));
+    size_t size = static_cast<size_t>(st.st_size);
+    return m_dirty ? std::max(size, m_start + m_offset) : size;
+}
+
+void BufferedFileStream::flush() { flush_buffer(); }
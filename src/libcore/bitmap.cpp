@@ -4,10 +4,433 @@
 #include <core/logger.h>
 
 #define TINYEXR_USE_MINIZ 0
+// decode and encode the scanline blocks / tiles of a file in parallel
+#define TINYEXR_USE_OPENMP 1
 #include <core/miniz.h>
 #define TINYEXR_IMPLEMENTATION
 #include <core/tinyexr.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__F16C__) || (defined(DOUBLE_PRECISION) && defined(__AVX2__))
+#include <immintrin.h>
+#endif
+#include <climits>
+
+namespace {
+/// Read-only private mapping of a whole file, unmapped on destruction
+struct MappedFile {
+    explicit MappedFile(const char *filename) {
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0)
+            Throw("Bitmap::load(): could not open {}", filename);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            Throw("Bitmap::load(): could not stat {} or file is empty", filename);
+        }
+        size = static_cast<size_t>(st.st_size);
+        void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED)
+            Throw("Bitmap::load(): could not map {}", filename);
+        // the decoder streams through the chunks front to back
+        madvise(ptr, size, MADV_SEQUENTIAL);
+        data = static_cast<const unsigned char *>(ptr);
+    }
+    ~MappedFile() { munmap(const_cast<unsigned char *>(data), size); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+};
+
+inline float half_to_float(uint16_t h)
+{
+#if defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    tinyexr::FP16 v;
+    v.u = h;
+    return tinyexr::half_to_float(v).f;
+#endif
+}
+
+inline uint16_t float_to_half(float f)
+{
+#if defined(__F16C__)
+    return _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+    tinyexr::FP32 v;
+    v.f = f;
+    return tinyexr::float_to_half_full(v).u;
+#endif
+}
+
+/*
+ * Texel codecs of the storage formats: load() / store() convert a single
+ * texel at a byte address from / to a Spectrum. The hot loops are
+ * instantiated once per codec through dispatch_format().
+ */
+struct TexelFull
+{
+    static constexpr size_t Size = sizeof(Spectrum);
+    static Spectrum load(const uint8_t *p)
+    {
+        Spectrum v;
+        memcpy(v.data(), p, Size);
+        return v;
+    }
+    static void store(uint8_t *p, const Spectrum &v) { memcpy(p, v.data(), Size); }
+};
+
+struct TexelFloat32
+{
+    static constexpr size_t Size = 3 * sizeof(float);
+    static Spectrum load(const uint8_t *p)
+    {
+        float v[3];
+        memcpy(v, p, Size);
+        return Spectrum(v[0], v[1], v[2]);
+    }
+    static void store(uint8_t *p, const Spectrum &v)
+    {
+        float f[3] = { (float) v[0], (float) v[1], (float) v[2] };
+        memcpy(p, f, Size);
+    }
+};
+
+struct TexelFloat16
+{
+    static constexpr size_t Size = 3 * sizeof(uint16_t);
+    static Spectrum load(const uint8_t *p)
+    {
+        uint16_t v[3];
+        memcpy(v, p, Size);
+        return Spectrum(half_to_float(v[0]), half_to_float(v[1]), half_to_float(v[2]));
+    }
+    static void store(uint8_t *p, const Spectrum &v)
+    {
+        uint16_t h[3] = { float_to_half((float) v[0]), float_to_half((float) v[1]),
+                          float_to_half((float) v[2]) };
+        memcpy(p, h, Size);
+    }
+};
+
+// Ward, "Real Pixels", Graphics Gems II
+struct TexelRGBE
+{
+    static constexpr size_t Size = 4;
+    static Spectrum load(const uint8_t *p)
+    {
+        if (p[3] == 0)
+            return Spectrum::Zero();
+        Float f = std::ldexp(Float(1), int(p[3]) - (128 + 8));
+        return Spectrum(p[0] + 0.5, p[1] + 0.5, p[2] + 0.5) * f;
+    }
+    /// Largest encodable component: mantissa 255 with the largest exponent (e = 127)
+    static Float maxValue() { return std::ldexp(Float(255), 127 - 8); }
+
+    static void store(uint8_t *p, const Spectrum &v)
+    {
+        // NaNs store as 0, larger values (and +Inf) clamp so that the exponent fits in 8 bits
+        Spectrum c;
+        for (int i = 0; i < 3; ++i)
+            c[i] = std::isnan(v[i]) ? Float(0) : std::min(std::max(v[i], Float(0)), maxValue());
+        Float m = c.maxCoeff();
+        if (!(m > 1e-32)) {
+            memset(p, 0, Size);
+            return;
+        }
+        int e;
+        Float scale = std::frexp(m, &e) * 256 / m;
+        for (int i = 0; i < 3; ++i)
+            p[i] = (uint8_t) std::min(c[i] * scale, Float(255));
+        p[3] = (uint8_t) (e + 128);
+    }
+};
+
+template <typename Func>
+decltype(auto) dispatch_format(Bitmap::StorageFormat format, Func &&func)
+{
+    switch (format) {
+        case Bitmap::StorageFormat::Float32: return func(TexelFloat32());
+        case Bitmap::StorageFormat::Float16: return func(TexelFloat16());
+        case Bitmap::StorageFormat::RGBE:    return func(TexelRGBE());
+        default:                             return func(TexelFull());
+    }
+}
+
+/// Storage index of texel (x, y) for the two layouts
+struct RowMajorIndex
+{
+    size_t width;
+    size_t operator()(int x, int y) const { return (size_t) y * width + x; }
+};
+
+struct TiledIndex
+{
+    size_t tiles_x;
+    size_t operator()(int x, int y) const
+    {
+        const int mask = Bitmap::TileSize - 1;
+        size_t tile = (size_t) (y >> Bitmap::TileShift) * tiles_x + (x >> Bitmap::TileShift);
+        return (tile << (2 * Bitmap::TileShift)) + ((y & mask) << Bitmap::TileShift) + (x & mask);
+    }
+};
+
+inline int tile_count(int n) { return (n + Bitmap::TileSize - 1) >> Bitmap::TileShift; }
+
+template <typename Func>
+decltype(auto) dispatch_layout(Bitmap::Layout layout, const Vector2i &res, Func &&func)
+{
+    if (layout == Bitmap::Layout::Tiled)
+        return func(TiledIndex{ (size_t) tile_count(res.x()) });
+    return func(RowMajorIndex{ (size_t) res.x() });
+}
+
+/// Texels and weights blended by a bilinear lookup
+struct Footprint
+{
+    int x, y, x1, y1;
+    Array2 w0, w1;
+};
+
+/// \c uv is already mapped to [0, 1)
+inline Footprint bilinear_footprint(const Vector2i &res, Array2 uv)
+{
+    Footprint f;
+    uv *= res.cast<Float>().array() - Array2(1, 1);
+    Array2i pos = uv.floor().cast<int>();
+    f.w1 = uv - pos.cast<Float>();
+    f.w0 = Array2(1, 1) - f.w1;
+    pos = pos.min(res.array() - Array2i(2, 2)).max(0);
+    // a single row or column (e.g. a coarse MIP level) repeats its texel
+    f.x = pos.x();
+    f.y = pos.y();
+    f.x1 = f.x + (res.x() > 1);
+    f.y1 = f.y + (res.y() > 1);
+    return f;
+}
+
+/// Bilinear lookup with wrap-around, \c uv is already mapped to [0, 1)
+template <typename Codec, typename Index>
+Spectrum bilinear(const uint8_t *data, const Vector2i &res, const Index &index, Array2 uv)
+{
+    const Footprint f = bilinear_footprint(res, uv);
+    Spectrum v00 = Codec::load(data + index(f.x, f.y) * Codec::Size),
+             v10 = Codec::load(data + index(f.x1, f.y) * Codec::Size),
+             v01 = Codec::load(data + index(f.x, f.y1) * Codec::Size),
+             v11 = Codec::load(data + index(f.x1, f.y1) * Codec::Size);
+
+    Spectrum v0 = v00 * f.w0.x() + v10 * f.w1.x(),
+             v1 = v01 * f.w0.x() + v11 * f.w1.x();
+    return f.w0.y() * v0 + f.w1.y() * v1;
+}
+
+inline const uint8_t *storage(const Bitmap &bitmap)
+{
+    return bitmap.m_format == Bitmap::StorageFormat::Full
+               ? reinterpret_cast<const uint8_t *>(bitmap.m_data.data())
+               : bitmap.m_packed.data();
+}
+
+#if defined(DOUBLE_PRECISION) && defined(__AVX2__)
+inline __m256d gather(const double *data, __m128i index)
+{
+    return _mm256_i32gather_pd(data, index, 8);
+}
+
+inline __m256d gather(const float *data, __m128i index)
+{
+    return _mm256_cvtps_pd(_mm_i32gather_ps(data, index, 4));
+}
+
+/**
+ * Four lookups of bilinear() on a row-major bitmap of 3-component texels,
+ * with the same operation order. \c T is the component type.
+ */
+template <typename T>
+void bilinear4(const T *data, const Vector2i &res, const Float *u, const Float *v,
+               bool flip_v, Float *r, Float *g, Float *b)
+{
+    const __m256d one = _mm256_set1_pd(1);
+    __m256d uu = _mm256_loadu_pd(u), vv = _mm256_loadu_pd(v);
+    if (flip_v)
+        vv = _mm256_xor_pd(vv, _mm256_set1_pd(-0.0));
+    uu = _mm256_sub_pd(uu, _mm256_floor_pd(uu));
+    vv = _mm256_sub_pd(vv, _mm256_floor_pd(vv));
+    uu = _mm256_mul_pd(uu, _mm256_set1_pd(res.x() - 1));
+    vv = _mm256_mul_pd(vv, _mm256_set1_pd(res.y() - 1));
+    __m256d fx = _mm256_floor_pd(uu), fy = _mm256_floor_pd(vv);
+    __m256d w1x = _mm256_sub_pd(uu, fx), w1y = _mm256_sub_pd(vv, fy);
+    __m256d w0x = _mm256_sub_pd(one, w1x), w0y = _mm256_sub_pd(one, w1y);
+
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ix = _mm_max_epi32(_mm_min_epi32(_mm256_cvttpd_epi32(fx), _mm_set1_epi32(res.x() - 2)), zero);
+    __m128i iy = _mm_max_epi32(_mm_min_epi32(_mm256_cvttpd_epi32(fy), _mm_set1_epi32(res.y() - 2)), zero);
+    __m128i i00 = _mm_mullo_epi32(_mm_add_epi32(_mm_mullo_epi32(iy, _mm_set1_epi32(res.x())), ix),
+                                  _mm_set1_epi32(3));
+    __m128i i10 = _mm_add_epi32(i00, _mm_set1_epi32(res.x() > 1 ? 3 : 0));
+    __m128i dy  = _mm_set1_epi32(res.y() > 1 ? 3 * res.x() : 0);
+    __m128i i01 = _mm_add_epi32(i00, dy), i11 = _mm_add_epi32(i10, dy);
+
+    Float *out[3] = { r, g, b };
+    for (int c = 0; c < 3; ++c) {
+        __m256d v0 = _mm256_add_pd(_mm256_mul_pd(gather(data + c, i00), w0x),
+                                   _mm256_mul_pd(gather(data + c, i10), w1x));
+        __m256d v1 = _mm256_add_pd(_mm256_mul_pd(gather(data + c, i01), w0x),
+                                   _mm256_mul_pd(gather(data + c, i11), w1x));
+        _mm256_storeu_pd(out[c], _mm256_add_pd(_mm256_mul_pd(w0y, v0), _mm256_mul_pd(w1y, v1)));
+    }
+}
+#endif
+
+/// Convert the R, G, B float planes of a decoded EXR image into texel storage
+template <typename Codec, typename Index>
+void store_planes(uint8_t *dst, const Index &index, const EXRHeader &header,
+                  const EXRImage &image, const int idx[3])
+{
+    const int width = image.width, height = image.height;
+    if (header.tiled) {
+#pragma omp parallel for schedule(dynamic)
+        for (int t = 0; t < image.num_tiles; ++t) {
+            const EXRTile &tile = image.tiles[t];
+            const float *r = reinterpret_cast<const float *>(tile.images[idx[0]]),
+                        *g = reinterpret_cast<const float *>(tile.images[idx[1]]),
+                        *b = reinterpret_cast<const float *>(tile.images[idx[2]]);
+            for (int j = 0; j < tile.height; ++j) {
+                int y = tile.offset_y * header.tile_size_y + j;
+                if (y >= height)
+                    break;
+                for (int i = 0; i < tile.width; ++i) {
+                    int x = tile.offset_x * header.tile_size_x + i;
+                    if (x >= width)
+                        break;
+                    int k = j * header.tile_size_x + i;
+                    Codec::store(dst + index(x, y) * Codec::Size, Spectrum(r[k], g[k], b[k]));
+                }
+            }
+        }
+    } else {
+        const float *r = reinterpret_cast<const float *>(image.images[idx[0]]),
+                    *g = reinterpret_cast<const float *>(image.images[idx[1]]),
+                    *b = reinterpret_cast<const float *>(image.images[idx[2]]);
+#pragma omp parallel for if ((int64_t) width * height > (1 << 16))
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x) {
+                size_t i = (size_t) y * width + x;
+                Codec::store(dst + index(x, y) * Codec::Size, Spectrum(r[i], g[i], b[i]));
+            }
+    }
+}
+} // namespace
+
+size_t Bitmap::texelSize(StorageFormat format)
+{
+    return dispatch_format(format, [](auto codec) { return decltype(codec)::Size; });
+}
+
+void Bitmap::allocate()
+{
+    size_t n = m_layout == Layout::Tiled
+                   ? ((size_t) tile_count(m_res.x()) * tile_count(m_res.y())) << (2 * TileShift)
+                   : (size_t) m_res.prod();
+    if (m_format == StorageFormat::Full) {
+        m_data.assign(n, Spectrum::Zero());
+        std::vector<uint8_t>().swap(m_packed);
+    } else {
+        m_packed.assign(n * texelSize(m_format), 0);
+        std::vector<Spectrum>().swap(m_data);
+    }
+}
+
+size_t Bitmap::storageIndex(size_t i) const
+{
+    if (m_layout == Layout::RowMajor)
+        return i;
+    return TiledIndex{ (size_t) tile_count(m_res.x()) }(i % m_res.x(), i / m_res.x());
+}
+
+Spectrum Bitmap::texel(size_t i) const
+{
+    i = storageIndex(i);
+    if (m_format == StorageFormat::Full)
+        return m_data[i];
+    return dispatch_format(m_format, [&](auto codec) {
+        using Codec = decltype(codec);
+        return Codec::load(m_packed.data() + i * Codec::Size);
+    });
+}
+
+void Bitmap::setTexel(size_t i, const Spectrum &value)
+{
+    i = storageIndex(i);
+    if (m_format == StorageFormat::Full) {
+        m_data[i] = value;
+        return;
+    }
+    dispatch_format(m_format, [&](auto codec) {
+        using Codec = decltype(codec);
+        Codec::store(m_packed.data() + i * Codec::Size, value);
+    });
+}
+
+void Bitmap::setStorageFormat(StorageFormat format)
+{
+    if (format == m_format)
+        return;
+    Bitmap tmp;
+    tmp.m_res = m_res;
+    tmp.m_format = format;
+    tmp.m_layout = m_layout;
+    tmp.allocate();
+    const int64_t size = (int64_t) m_res.prod();
+#pragma omp parallel for if (size > (1 << 16))
+    for (int64_t i = 0; i < size; ++i)
+        tmp.setTexel(i, texel(i));
+    m_data.swap(tmp.m_data);
+    m_packed.swap(tmp.m_packed);
+    m_format = format;
+}
+
+void Bitmap::setLayout(Layout layout)
+{
+    if (layout == m_layout)
+        return;
+    Bitmap tmp;
+    tmp.m_res = m_res;
+    tmp.m_format = m_format;
+    tmp.m_layout = layout;
+    tmp.allocate();
+    const int64_t size = (int64_t) m_res.prod();
+#pragma omp parallel for if (size > (1 << 16))
+    for (int64_t i = 0; i < size; ++i)
+        tmp.setTexel(i, texel(i));
+    m_data.swap(tmp.m_data);
+    m_packed.swap(tmp.m_packed);
+    m_layout = layout;
+}
+
+Bitmap &Bitmap::operator+=(const Bitmap &rhs)
+{
+    const size_t size = (size_t) m_res.prod();
+    if (m_format == StorageFormat::Full && rhs.m_format == StorageFormat::Full &&
+        m_layout == rhs.m_layout) {
+        // same storage order, padding included
+        for (size_t i = 0; i < m_data.size(); ++i)
+            m_data[i] += rhs.m_data[i];
+    } else {
+        for (size_t i = 0; i < size; ++i)
+            setTexel(i, texel(i) + rhs.texel(i));
+    }
+    return *this;
+}
+
 Bitmap::Bitmap(const ArrayXd &data, const Vector2i &res)
 {
     m_data = from_tensor_to_spectrum_list(
@@ -18,142 +441,261 @@ Bitmap::Bitmap(const ArrayXd &data, const Vector2i &res)
 void Bitmap::fill(const Spectrum &value)
 {
     m_res = Vector2i(1, 1);
-    m_data.resize(1);
-    m_data[0] = value;
+    allocate();
+    setTexel(0, value);
+}
+
+void Bitmap::resize(const Vector2i &res)
+{
+    m_res = res;
+    allocate();
 }
 
 void Bitmap::setZero()
 {
     for (auto &v : m_data)
         v.setZero();
+    // all-zero bits are 0 in every compact format
+    std::fill(m_packed.begin(), m_packed.end(), 0);
 }
 
-void Bitmap::load(const char *filename)
+void Bitmap::load(const char *filename, StorageFormat format)
 {
-    float *out; // width * height * RGBA
-    int width;
-    int height;
-    const char *err = NULL; // or nullptr in C++11
+    MappedFile file(filename);
+    EXRVersion version;
+    EXRHeader header;
+    EXRImage image;
+    InitEXRHeader(&header);
+    InitEXRImage(&image);
+    const char *err = NULL;
 
-    int ret = LoadEXR(&out, &width, &height, filename, &err);
-    int size = width * height;
+    int ret = ParseEXRVersionFromMemory(&version, file.data, file.size);
+    if (ret == TINYEXR_SUCCESS && (version.multipart || version.non_image))
+        Throw("Bitmap::load(): multi-part and deep EXR files are not supported: {}", filename);
+    if (ret == TINYEXR_SUCCESS)
+        ret = ParseEXRHeaderFromMemory(&header, &version, file.data, file.size, &err);
+    if (ret == TINYEXR_SUCCESS) {
+        // decode every channel (HALF included) straight to float planes
+        for (int i = 0; i < header.num_channels; ++i)
+            if (header.pixel_types[i] == TINYEXR_PIXELTYPE_HALF)
+                header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
+        ret = LoadEXRImageFromMemory(&image, &header, file.data, file.size, &err);
+    }
+    if (ret != TINYEXR_SUCCESS) {
+        std::string msg = err ? err : "unknown error";
+        FreeEXRErrorMessage(err);
+        FreeEXRHeader(&header);
+        Throw("Bitmap::load(): failed to read {}: {}", filename, msg);
+    }
 
-    if (ret != TINYEXR_SUCCESS)
-    {
-        if (err)
-        {
-            fprintf(stderr, "ERR : %s\n", err);
-            FreeEXRErrorMessage(err); // release memory of error message.
+    // R, G, B planes, or a single luminance plane replicated to all three
+    int idx[3] = { -1, -1, -1 };
+    for (int c = 0; c < header.num_channels; ++c) {
+        const char *name = header.channels[c].name;
+        if (strcmp(name, "R") == 0) idx[0] = c;
+        else if (strcmp(name, "G") == 0) idx[1] = c;
+        else if (strcmp(name, "B") == 0) idx[2] = c;
+    }
+    if (idx[0] < 0 || idx[1] < 0 || idx[2] < 0) {
+        if (header.num_channels != 1) {
+            FreeEXRImage(&image);
+            FreeEXRHeader(&header);
+            Throw("Bitmap::load(): {} has no R, G, B channels", filename);
         }
+        idx[0] = idx[1] = idx[2] = 0;
     }
-
-    m_data.resize(size);
-    int offset = 0;
-    for (int i = 0; i < height; ++i)
-        for (int j = 0; j < width; ++j)
-        {
-            m_data[offset] = Spectrum(out[offset * 4 + 0],
-                                      out[offset * 4 + 1],
-                                      out[offset * 4 + 2]);
-            ++offset;
+    for (int c : idx)
+        if (header.pixel_types[c] != TINYEXR_PIXELTYPE_FLOAT) {
+            FreeEXRImage(&image);
+            FreeEXRHeader(&header);
+            Throw("Bitmap::load(): {} has a non-float color channel", filename);
         }
-    free(out); // release memory of image data
+
+    int width = image.width, height = image.height;
     m_res = Vector2i(width, height);
+    m_format = format;
+    allocate();
+    uint8_t *dst = const_cast<uint8_t *>(storage(*this));
+    dispatch_layout(m_layout, m_res, [&](auto index) {
+        dispatch_format(m_format, [&](auto codec) {
+            store_planes<decltype(codec)>(dst, index, header, image, idx);
+        });
+    });
+    FreeEXRImage(&image);
+    FreeEXRHeader(&header);
 }
 
-void Bitmap::save(const char *filename) const {
-    int width = m_res.x();
-    int height = m_res.y();
-    EXRHeader header;
-    InitEXRHeader(&header);
+void Bitmap::save(const char *filename, Compression compression,
+                  ComponentFormat format) const
+{
+    const int width = m_res.x(), height = m_res.y();
+    const int64_t size = (int64_t) width * height;
+
+    // Must be (A)BGR order, since most of EXR viewers expect this channel order.
+    std::vector<float> planes(3 * size);
+    float *image_ptr[3] = { planes.data(), planes.data() + size, planes.data() + 2 * size };
+#pragma omp parallel for if (size > (1 << 16))
+    for (int64_t i = 0; i < size; ++i) {
+        Spectrum v = texel(i);
+        image_ptr[0][i] = (float) v.z();
+        image_ptr[1][i] = (float) v.y();
+        image_ptr[2][i] = (float) v.x();
+    }
 
     EXRImage image;
     InitEXRImage(&image);
-
     image.num_channels = 3;
-
-    std::vector<float> images[3];
-    images[0].resize(width * height);
-    images[1].resize(width * height);
-    images[2].resize(width * height);
-
-    for (int i = 0; i < width * height; i++) {
-      images[0][i] = m_data[i].x();
-      images[1][i] = m_data[i].y();
-      images[2][i] = m_data[i].z();
-    }
-
-    float* image_ptr[3];
-    image_ptr[0] = &(images[2].at(0)); // B
-    image_ptr[1] = &(images[1].at(0)); // G
-    image_ptr[2] = &(images[0].at(0)); // R
-
-    image.images = (unsigned char**)image_ptr;
+    image.images = (unsigned char **) image_ptr;
     image.width = width;
     image.height = height;
 
-    header.num_channels = 3;
-    header.channels = (EXRChannelInfo *)malloc(sizeof(EXRChannelInfo) * header.num_channels);
-    // Must be (A)BGR order, since most of EXR viewers expect this channel order.
-    strncpy(header.channels[0].name, "B", 255); header.channels[0].name[strlen("B")] = '\0';
-    strncpy(header.channels[1].name, "G", 255); header.channels[1].name[strlen("G")] = '\0';
-    strncpy(header.channels[2].name, "R", 255); header.channels[2].name[strlen("R")] = '\0';
+    EXRHeader header;
+    InitEXRHeader(&header);
+    switch (compression) {
+        case Compression::None: header.compression_type = TINYEXR_COMPRESSIONTYPE_NONE; break;
+        case Compression::ZIP:  header.compression_type = TINYEXR_COMPRESSIONTYPE_ZIP; break;
+        case Compression::PIZ:  header.compression_type = TINYEXR_COMPRESSIONTYPE_PIZ; break;
+    }
 
-    header.pixel_types = (int *)malloc(sizeof(int) * header.num_channels);
-    header.requested_pixel_types = (int *)malloc(sizeof(int) * header.num_channels);
-    for (int i = 0; i < header.num_channels; i++) {
-      header.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT; // pixel type of input image
-      header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF; // pixel type of output image to be stored in .EXR
+    EXRChannelInfo channels[3];
+    memset(channels, 0, sizeof(channels));
+    strcpy(channels[0].name, "B");
+    strcpy(channels[1].name, "G");
+    strcpy(channels[2].name, "R");
+    int pixel_types[3], requested_pixel_types[3];
+    for (int i = 0; i < 3; i++) {
+        pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT; // pixel type of input image
+        requested_pixel_types[i] = format == ComponentFormat::Float32
+                                       ? TINYEXR_PIXELTYPE_FLOAT
+                                       : TINYEXR_PIXELTYPE_HALF; // pixel type stored in .EXR
     }
+    header.num_channels = 3;
+    header.channels = channels;
+    header.pixel_types = pixel_types;
+    header.requested_pixel_types = requested_pixel_types;
 
-    const char* err = NULL; // or nullptr in C++11 or later.
+    const char *err = NULL;
     int ret = SaveEXRImageToFile(&image, &header, filename, &err);
     if (ret != TINYEXR_SUCCESS) {
-      PSDR_ERROR("Save EXR err: %s\n", err);
-      FreeEXRErrorMessage(err); // free's buffer for an error message
-      return;
+        PSDR_ERROR("Save EXR err: {}", err ? err : "unknown error");
+        FreeEXRErrorMessage(err);
+        return;
     }
     PSDR_INFO("Saved exr file. {} \n", filename);
-
-    free(header.channels);
-    free(header.pixel_types);
-    free(header.requested_pixel_types);
 }
 
 Spectrum Bitmap::eval(const Vector2 &_uv, bool flip_v) const
 {
     if (m_res.x() == 1 && m_res.y() == 1)
-        return m_data[0];
+        return texel(0);
     Array2 uv = _uv.array();
     if (flip_v)
         uv.y() = -uv.y();
     uv -= uv.floor();
-    uv *= m_res.cast<Float>().array() - Array2(1, 1);
-    Array2i pos = uv.floor().cast<int>();
-    Array2 w1 = uv - pos.cast<Float>();
-    Array2 w0 = Array2(1, 1) - w1;
-    pos = pos.min(m_res.array() - Array2i(2, 2));
-    int index = pos.y() * m_res.x() + pos.x();
-    Spectrum v00 = m_data[index],
-             v10 = m_data[index + 1],
-             v01 = m_data[index + m_res.x()],
-             v11 = m_data[index + m_res.x() + 1];
-
-    Spectrum v0 = v00 * w0.x() + v10 * w1.x(),
-             v1 = v01 * w0.x() + v11 * w1.x();
-    Spectrum ret = w0.y() * v0 + w1.y() * v1;
+    Spectrum ret = dispatch_layout(m_layout, m_res, [&](auto index) {
+        if (m_format == StorageFormat::Full)
+            return bilinear<TexelFull>(storage(*this), m_res, index, uv);
+        return dispatch_format(m_format, [&](auto codec) {
+            return bilinear<decltype(codec)>(storage(*this), m_res, index, uv);
+        });
+    });
     assert(ret.allFinite());
     return ret;
 }
 
+void Bitmap::evalFootprint(const Vector2 &_uv, bool flip_v, int index[4], Float weight[4]) const
+{
+    Array2 uv = _uv.array();
+    if (flip_v)
+        uv.y() = -uv.y();
+    uv -= uv.floor();
+    const Footprint f = bilinear_footprint(m_res, uv);
+    index[0] = f.y * m_res.x() + f.x;
+    index[1] = f.y * m_res.x() + f.x1;
+    index[2] = f.y1 * m_res.x() + f.x;
+    index[3] = f.y1 * m_res.x() + f.x1;
+    weight[0] = f.w0.x() * f.w0.y();
+    weight[1] = f.w1.x() * f.w0.y();
+    weight[2] = f.w0.x() * f.w1.y();
+    weight[3] = f.w1.x() * f.w1.y();
+}
+
+void Bitmap::evalBatch(const Float *u, const Float *v, size_t count,
+                       Float *r, Float *g, Float *b, bool flip_v) const
+{
+    if (m_res.x() == 1 && m_res.y() == 1) {
+        Spectrum value = texel(0);
+        std::fill(r, r + count, value[0]);
+        std::fill(g, g + count, value[1]);
+        std::fill(b, b + count, value[2]);
+        return;
+    }
+
+    size_t i = 0;
+#if defined(DOUBLE_PRECISION) && defined(__AVX2__)
+    // 32-bit gather offsets
+    if (m_layout == Layout::RowMajor && 3 * (int64_t) m_res.prod() < INT_MAX) {
+        if (m_format == StorageFormat::Full)
+            for (; i + 4 <= count; i += 4)
+                bilinear4(m_data.data()->data(), m_res, u + i, v + i, flip_v, r + i, g + i, b + i);
+        else if (m_format == StorageFormat::Float32)
+            for (; i + 4 <= count; i += 4)
+                bilinear4(reinterpret_cast<const float *>(m_packed.data()), m_res, u + i, v + i,
+                          flip_v, r + i, g + i, b + i);
+    }
+#endif
+    if (i == count)
+        return;
+
+    // remaining lookups and the other formats and layouts
+    dispatch_layout(m_layout, m_res, [&](auto index) {
+        dispatch_format(m_format, [&](auto codec) {
+            using Codec = decltype(codec);
+            const uint8_t *data = storage(*this);
+            for (; i < count; ++i) {
+                Array2 uv(u[i], flip_v ? -v[i] : v[i]);
+                uv -= uv.floor();
+                Spectrum value = bilinear<Codec>(data, m_res, index, uv);
+                r[i] = value[0];
+                g[i] = value[1];
+                b[i] = value[2];
+            }
+        });
+    });
+}
+
 ArrayXd Bitmap::getData() const
 {
-    return from_spectrum_list_to_tensor(m_data, m_res.prod());
+    if (m_format == StorageFormat::Full && m_layout == Layout::RowMajor)
+        return from_spectrum_list_to_tensor(m_data, m_res.prod());
+    ArrayXd ret(3 * (size_t) m_res.prod());
+    for (int i = 0; i < m_res.prod(); ++i)
+        ret.segment<3>(3 * i) = texel(i);
+    return ret;
 }
 
 void Bitmap::setData(const ArrayXd &data)
 {
-    m_data = from_tensor_to_spectrum_list(data, m_res.prod());
+    if (m_format == StorageFormat::Full && m_layout == Layout::RowMajor) {
+        from_tensor_to_spectrum_list(data, m_res.prod(), m_data);
+        return;
+    }
+    for (int i = 0; i < m_res.prod(); ++i)
+        setTexel(i, data.segment<3>(3 * i));
+}
+
+Eigen::Map<Eigen::Array<Float, Eigen::Dynamic, 1>> Bitmap::dataView()
+{
+    PSDR_ASSERT_MSG(m_format == StorageFormat::Full && m_layout == Layout::RowMajor,
+                    "Bitmap::dataView(): requires row-major Full storage");
+    return spectrum_list_as_tensor(m_data, m_res.prod());
+}
+
+Eigen::Map<const Eigen::Array<Float, Eigen::Dynamic, 1>> Bitmap::dataView() const
+{
+    PSDR_ASSERT_MSG(m_format == StorageFormat::Full && m_layout == Layout::RowMajor,
+                    "Bitmap::dataView(): requires row-major Full storage");
+    return spectrum_list_as_tensor(m_data, m_res.prod());
 }
 
 std::string Bitmap::toString() const
@@ -0,0 +1,112 @@
+#include <core/bitmap_grad.h>
+#include <core/logger.h>
+
+#include <algorithm>
+
+BitmapGrad::BitmapGrad(const Vector2i &res, int nworker)
+    : m_res(res), m_slots(nworker)
+{
+    PSDR_ASSERT((res.array() > 0).all() && nworker > 0);
+    m_tiles = Vector2i((res.x() + TileSize - 1) >> TileShift, (res.y() + TileSize - 1) >> TileShift);
+}
+
+BitmapGrad::Slot &BitmapGrad::slot()
+{
+    int tid = omp_get_thread_num();
+    PSDR_ASSERT_MSG(tid < (int) m_slots.size(), "BitmapGrad: thread {} but only {} slots", tid,
+                    m_slots.size());
+    return m_slots[tid];
+}
+
+void BitmapGrad::accumulate(int x, int y, const Spectrum &grad)
+{
+    assert(x >= 0 && x < m_res.x() && y >= 0 && y < m_res.y());
+    Slot &s = slot();
+    const int t = (y >> TileShift) * m_tiles.x() + (x >> TileShift);
+    Tile *&tile = s.directory[t];
+    if (!tile) {
+        s.tiles.emplace_back(new Tile);
+        tile = s.tiles.back().get();
+        for (auto &v : tile->texel)
+            v.setZero();
+    }
+    const int mask = TileSize - 1;
+    tile->texel[((y & mask) << TileShift) + (x & mask)] += grad;
+}
+
+void BitmapGrad::accumulateEval(const Bitmap &bitmap, const Vector2 &uv, const Spectrum &d_out,
+                                bool flip_v)
+{
+    assert(bitmap.m_res == m_res);
+    int index[4];
+    Float weight[4];
+    bitmap.evalFootprint(uv, flip_v, index, weight);
+    for (int i = 0; i < 4; ++i)
+        if (weight[i] != 0)
+            accumulate(index[i] % m_res.x(), index[i] / m_res.x(), weight[i] * d_out);
+}
+
+std::vector<int> BitmapGrad::touchedTiles() const
+{
+    std::vector<int> ret;
+    for (const auto &s : m_slots)
+        for (const auto &entry : s.directory)
+            ret.push_back(entry.first);
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    return ret;
+}
+
+void BitmapGrad::merge(ArrayXd &grad) const
+{
+    PSDR_ASSERT(grad.size() == 3 * (int64_t) m_res.prod());
+    const std::vector<int> tiles = touchedTiles();
+#pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < (int) tiles.size(); ++k) {
+        const int t = tiles[k];
+        const int x0 = (t % m_tiles.x()) << TileShift, y0 = (t / m_tiles.x()) << TileShift;
+        const int nx = std::min(TileSize, m_res.x() - x0), ny = std::min(TileSize, m_res.y() - y0);
+        for (const auto &s : m_slots) {
+            auto it = s.directory.find(t);
+            if (it == s.directory.end())
+                continue;
+            const Tile *tile = it->second;
+            for (int j = 0; j < ny; ++j)
+                for (int i = 0; i < nx; ++i)
+                    grad.segment<3>(3 * ((size_t) (y0 + j) * m_res.x() + x0 + i)) +=
+                        tile->texel[(j << TileShift) + i];
+        }
+    }
+}
+
+ArrayXd BitmapGrad::grad() const
+{
+    ArrayXd ret = ArrayXd::Zero(3 * (int64_t) m_res.prod());
+    merge(ret);
+    return ret;
+}
+
+void BitmapGrad::setZero()
+{
+#pragma omp parallel for
+    for (int k = 0; k < (int) m_slots.size(); ++k)
+        for (auto &tile : m_slots[k].tiles)
+            for (auto &v : tile->texel)
+                v.setZero();
+}
+
+void BitmapGrad::clear()
+{
+    for (auto &s : m_slots) {
+        s.directory.clear();
+        s.tiles.clear();
+    }
+}
+
+size_t BitmapGrad::allocatedTiles() const
+{
+    size_t n = 0;
+    for (const auto &s : m_slots)
+        n += s.tiles.size();
+    return n;
+}
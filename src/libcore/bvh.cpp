@@ -0,0 +1,361 @@
+#include <core/bvh.h>
+#include <core/logger.h>
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
+namespace {
+/// Relative cost of a traversal step compared to a triangle test
+constexpr Float TraversalCost = 1;
+/// Subtrees with fewer triangles are built by the task that creates them
+constexpr uint32_t TaskThreshold = 4096;
+/// From this depth on, SAH splits are replaced by median splits to bound the tree depth
+constexpr int SAHDepth = 32;
+
+/// Round \c x to a float below it, one more ulp down to absorb the rounding of ray origins
+inline float round_down(Float x)
+{
+    float f = static_cast<float>(x);
+    if (f > x)
+        f = std::nextafter(f, -std::numeric_limits<float>::infinity());
+    return std::nextafter(f, -std::numeric_limits<float>::infinity());
+}
+
+inline float round_up(Float x)
+{
+    float f = static_cast<float>(x);
+    if (f < x)
+        f = std::nextafter(f, std::numeric_limits<float>::infinity());
+    return std::nextafter(f, std::numeric_limits<float>::infinity());
+}
+
+/// Single precision counterpart of simd::RayInv
+struct RayInv32
+{
+    RayInv32(const simd::WatertightRay &ray, const Ray &r)
+        : org(ray.org), inv_dir(r.dir.cast<float>().cwiseInverse()), tmin(ray.tmin), tmax(ray.tmax) {}
+
+    Vector3f org, inv_dir;
+    float tmin, tmax;
+};
+
+/// Single precision counterpart of simd::rayIntersect(RayInv, AABB)
+inline bool slab(const RayInv32 &ray, const BVH::Node32 &node)
+{
+    constexpr float robust = 1 + 4 * std::numeric_limits<float>::epsilon();
+    float tmin = ray.tmin, tmax = ray.tmax;
+    for (int a = 0; a < 3; ++a) {
+        float t0 = (node.min[a] - ray.org[a]) * ray.inv_dir[a], t1 = (node.max[a] - ray.org[a]) * ray.inv_dir[a];
+        if (ray.inv_dir[a] < 0)
+            std::swap(t0, t1);
+        // widen the far distance away from the near one, see simd::slabFar
+        t1 *= t1 >= 0 ? robust : 1 / robust;
+        tmin = t0 > tmin ? t0 : tmin;
+        tmax = t1 < tmax ? t1 : tmax;
+    }
+    return tmin <= tmax;
+}
+
+struct Builder
+{
+    const std::vector<AABB> &prim_bounds;
+    const std::vector<Vector> &centroids;
+    std::vector<int> &indices;
+    std::vector<BVH::Node> &nodes;
+    uint32_t max_leaf; // largest leaf the SAH may keep
+    std::atomic<uint32_t> next_node{ 1 };
+
+    void build(uint32_t index, uint32_t begin, uint32_t end, int depth)
+    {
+        BVH::Node &node = nodes[index];
+        AABB centroid_bounds;
+        node.bounds.reset();
+        for (uint32_t i = begin; i < end; ++i) {
+            node.bounds.expandBy(prim_bounds[indices[i]]);
+            centroid_bounds.expandBy(centroids[indices[i]]);
+        }
+
+        const uint32_t n = end - begin;
+        const int axis = centroid_bounds.getLargestAxis();
+        const Float lo = centroid_bounds.min[axis], extent = centroid_bounds.getExtents()[axis];
+        if (n <= 1 || (n <= max_leaf && (depth >= SAHDepth || !(extent > 0)))) {
+            makeLeaf(node, begin, n);
+            return;
+        }
+
+        uint32_t mid;
+        if (depth >= SAHDepth || !(extent > 0)) {
+            mid = begin + n / 2;
+            std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+                             [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        } else {
+            auto bin = [&](int prim) {
+                int k = static_cast<int>(BVH::BinCount * ((centroids[prim][axis] - lo) / extent));
+                return std::min(std::max(k, 0), BVH::BinCount - 1);
+            };
+            AABB bins[BVH::BinCount];
+            uint32_t counts[BVH::BinCount] = {};
+            for (uint32_t i = begin; i < end; ++i) {
+                int k = bin(indices[i]);
+                bins[k].expandBy(prim_bounds[indices[i]]);
+                ++counts[k];
+            }
+
+            // right-to-left sweep, then evaluate each split left-to-right
+            Float right_area[BVH::BinCount];
+            AABB acc;
+            for (int k = BVH::BinCount - 1; k > 0; --k) {
+                acc.expandBy(bins[k]);
+                right_area[k] = acc.surfaceArea();
+            }
+            acc.reset();
+            uint32_t nl = 0;
+            int best = -1;
+            Float best_cost = std::numeric_limits<Float>::infinity();
+            for (int k = 1; k < BVH::BinCount; ++k) {
+                acc.expandBy(bins[k - 1]);
+                nl += counts[k - 1];
+                if (nl == 0 || nl == n)
+                    continue;
+                Float cost = acc.surfaceArea() * nl + right_area[k] * (n - nl);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best = k;
+                }
+            }
+            best_cost = TraversalCost + best_cost / node.bounds.surfaceArea();
+            if (best < 0 || (n <= max_leaf && best_cost >= n)) {
+                makeLeaf(node, begin, n);
+                return;
+            }
+            mid = static_cast<uint32_t>(
+                std::partition(indices.begin() + begin, indices.begin() + end,
+                               [&](int prim) { return bin(prim) < best; }) -
+                indices.begin());
+        }
+
+        const uint32_t left = next_node.fetch_add(2);
+        node.offset = left;
+        node.count = 0;
+        node.axis = static_cast<uint16_t>(axis);
+#pragma omp task if (mid - begin > TaskThreshold)
+        build(left, begin, mid, depth + 1);
+        build(left + 1, mid, end, depth + 1);
+    }
+
+    void makeLeaf(BVH::Node &node, uint32_t begin, uint32_t n)
+    {
+        node.offset = begin;
+        node.count = static_cast<uint16_t>(n);
+        node.axis = 0;
+        node.pack = 0;
+    }
+};
+} // namespace
+
+void BVH::build(const std::vector<Vector> &vertices, const std::vector<Vector3i> &faces,
+                Precision precision)
+{
+    const int n = static_cast<int>(faces.size());
+    m_precision = precision;
+    m_bounds.reset();
+    m_nodes.clear();
+    m_packs.clear();
+    m_nodes32.clear();
+    m_packs32.clear();
+    m_indices.resize(n);
+    if (n == 0)
+        return;
+
+    std::vector<AABB> prim_bounds(n);
+    std::vector<Vector> centroids(n);
+#pragma omp parallel for if (n > (1 << 14))
+    for (int i = 0; i < n; ++i) {
+        const Vector3i &f = faces[i];
+        assert((f.array() >= 0).all() && (f.array() < (int) vertices.size()).all());
+        AABB &b = prim_bounds[i];
+        b = AABB(vertices[f[0]]);
+        b.expandBy(vertices[f[1]]);
+        b.expandBy(vertices[f[2]]);
+        centroids[i] = b.getCenter();
+        m_indices[i] = i;
+    }
+
+    m_nodes.resize(2 * (size_t) n - 1);
+    Builder builder{ prim_bounds, centroids, m_indices, m_nodes,
+                     precision == Precision::Mixed ? (uint32_t) PackSize32 : (uint32_t) MaxLeafSize };
+#pragma omp parallel
+#pragma omp single
+    builder.build(0, 0, n, 0);
+    m_nodes.resize(builder.next_node);
+    m_nodes.shrink_to_fit();
+    m_bounds = m_nodes[0].bounds;
+
+    std::vector<uint32_t> leaves;
+    size_t packs = 0;
+    for (uint32_t k = 0; k < (uint32_t) m_nodes.size(); ++k)
+        if (m_nodes[k].isLeaf()) {
+            m_nodes[k].pack = static_cast<uint32_t>(packs);
+            packs += (m_nodes[k].count + PackSize - 1) / PackSize;
+            leaves.push_back(k);
+        }
+
+    if (precision == Precision::Mixed) {
+        // leaves hold at most PackSize32 triangles, i.e. exactly one single precision pack
+        m_nodes32.resize(m_nodes.size());
+        m_packs32.resize(leaves.size());
+        std::vector<uint32_t> leaf_index(m_nodes.size());
+        for (uint32_t k = 0; k < (uint32_t) leaves.size(); ++k)
+            leaf_index[leaves[k]] = k;
+#pragma omp parallel for if (n > (1 << 14))
+        for (int k = 0; k < (int) m_nodes.size(); ++k) {
+            const Node &node = m_nodes[k];
+            Node32 &node32 = m_nodes32[k];
+            for (int a = 0; a < 3; ++a) {
+                node32.min[a] = round_down(node.bounds.min[a]);
+                node32.max[a] = round_up(node.bounds.max[a]);
+            }
+            node32.count = node.count;
+            node32.axis = node.axis;
+            node32.offset = node.isLeaf() ? leaf_index[k] : node.offset;
+            if (node.isLeaf())
+                for (int i = 0; i < node.count; ++i) {
+                    const int tri = m_indices[node.offset + i];
+                    const Vector3i &f = faces[tri];
+                    m_packs32[leaf_index[k]].set(i, vertices[f[0]], vertices[f[1]], vertices[f[2]], tri);
+                }
+        }
+        std::vector<Node>().swap(m_nodes);
+        return;
+    }
+
+    m_packs.resize(packs);
+#pragma omp parallel for if (n > (1 << 14))
+    for (int k = 0; k < (int) leaves.size(); ++k) {
+        const Node &node = m_nodes[leaves[k]];
+        for (int i = 0; i < node.count; ++i) {
+            const int tri = m_indices[node.offset + i];
+            const Vector3i &f = faces[tri];
+            m_packs[node.pack + i / PackSize].set(i % PackSize, vertices[f[0]], vertices[f[1]],
+                                                  vertices[f[2]], tri);
+        }
+    }
+}
+
+template <bool Any>
+bool BVH::traverse(const Ray &_ray, Hit &hit) const
+{
+    if (m_nodes.empty())
+        return false;
+    Ray ray(_ray);
+    simd::RayInv inv(ray);
+    const bool negative[3] = { inv.inv_dir.x() < 0, inv.inv_dir.y() < 0, inv.inv_dir.z() < 0 };
+
+    uint32_t stack[MaxDepth];
+    int size = 0;
+    uint32_t index = 0;
+    bool found = false;
+    while (true) {
+        const Node &node = m_nodes[index];
+        Float nearT;
+        if (simd::rayIntersect(inv, node.bounds, nearT)) {
+            if (!node.isLeaf()) {
+                // visit the child on the near side of the split first
+                const uint32_t near = node.offset + negative[node.axis];
+                stack[size++] = node.offset + !negative[node.axis];
+                index = near;
+                continue;
+            }
+            const uint32_t end = node.pack + (node.count + PackSize - 1) / PackSize;
+            for (uint32_t p = node.pack; p < end; ++p) {
+                Float u[PackSize], w[PackSize], t[PackSize];
+                uint32_t mask = simd::rayIntersect(ray, m_packs[p], u, w, t);
+                if (Any && mask)
+                    return true;
+                for (; mask; mask &= mask - 1) {
+                    const int i = __builtin_ctz(mask);
+                    if (t[i] <= ray.tmax) {
+                        hit = Hit{ m_packs[p].index[i], u[i], w[i], t[i] };
+                        ray.tmax = inv.tmax = t[i];
+                        found = true;
+                    }
+                }
+            }
+        }
+        if (size == 0)
+            break;
+        index = stack[--size];
+    }
+    return found;
+}
+
+template <bool Any>
+bool BVH::traverse32(const Ray &_ray, Hit &hit) const
+{
+    if (m_nodes32.empty())
+        return false;
+    simd::WatertightRay ray(_ray);
+    RayInv32 inv(ray, _ray);
+    const bool negative[3] = { inv.inv_dir.x() < 0, inv.inv_dir.y() < 0, inv.inv_dir.z() < 0 };
+
+    uint32_t stack[MaxDepth];
+    int size = 0;
+    uint32_t index = 0;
+    bool found = false;
+    while (true) {
+        const Node32 &node = m_nodes32[index];
+        if (slab(inv, node)) {
+            if (!node.isLeaf()) {
+                const uint32_t near = node.offset + negative[node.axis];
+                stack[size++] = node.offset + !negative[node.axis];
+                index = near;
+                continue;
+            }
+            const TrianglePack32 &pack = m_packs32[node.offset];
+            float u[PackSize32], w[PackSize32], t[PackSize32];
+            uint32_t mask = simd::rayIntersect(ray, pack, u, w, t);
+            if (Any && mask)
+                return true;
+            for (; mask; mask &= mask - 1) {
+                const int i = __builtin_ctz(mask);
+                if (t[i] <= ray.tmax) {
+                    hit = Hit{ pack.index[i], u[i], w[i], t[i] };
+                    ray.tmax = inv.tmax = t[i];
+                    found = true;
+                }
+            }
+        }
+        if (size == 0)
+            break;
+        index = stack[--size];
+    }
+    return found;
+}
+
+bool BVH::rayIntersect(const Ray &ray, Hit &hit) const
+{
+    hit = Hit();
+    if (m_precision == Precision::Mixed)
+        return traverse32<false>(ray, hit);
+    return traverse<false>(ray, hit);
+}
+
+bool BVH::rayOccluded(const Ray &ray) const
+{
+    Hit hit;
+    if (m_precision == Precision::Mixed)
+        return traverse32<true>(ray, hit);
+    return traverse<true>(ray, hit);
+}
+
+std::string BVH::toString() const
+{
+    std::ostringstream oss;
+    oss << "BVH[triangles=" << triangleCount() << ", nodes=" << nodeCount()
+        << ", precision=" << (m_precision == Precision::Mixed ? "mixed" : "double");
+    if (!empty())
+        oss << ", bounds=" << bounds().toString();
+    oss << "]";
+    return oss.str();
+}
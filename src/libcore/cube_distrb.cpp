@@ -1,5 +1,6 @@
 #include <core/cube_distrb.h>
 #include <core/logger.h>
+#include <core/simd.h>
 #include <core/utils.h>
 
 /**
@@ -28,31 +29,92 @@ void CubeDistribution::set_resolution(const Array2i &res) {
     }
 }
 
+/**
+ * \brief Evaluate the mass of the cells in [lo, hi) into m_mass
+ * Cells of one column are contiguous in m_mass, so every column is looked
+ * up with batched Bitmap::evalBatch calls.
+ */
+void CubeDistribution::eval_mass(const Bitmap &radiance, const Array2i &lo,
+                                 const Array2i &hi) {
+    const int height = m_res[1];
+#pragma omp parallel
+    {
+        Float u[simd::BatchChunk], v[simd::BatchChunk];
+        Float r[simd::BatchChunk], g[simd::BatchChunk], b[simd::BatchChunk];
+#pragma omp for
+        for (int x = lo[0]; x < hi[0]; ++x)
+            for (int y0 = lo[1]; y0 < hi[1]; y0 += (int) simd::BatchChunk) {
+                int n = std::min((int) simd::BatchChunk, hi[1] - y0);
+                for (int k = 0; k < n; ++k) {
+                    u[k] = (x + 0.5) * m_unit[0];
+                    v[k] = (y0 + k + 0.5) * m_unit[1];
+                }
+                radiance.evalBatch(u, v, n, r, g, b, false);
+                Float *mass = m_mass.data() + x * height + y0;
+                for (int k = 0; k < n; ++k)
+                    mass[k] = rgb2luminance(Spectrum(r[k], g[k], b[k])) *
+                              m_sin_theta[y0 + k]; // NOTE reference
+            }
+    }
+}
+
+/**
+ * \brief Evaluate the mass of every cell and rebuild the sampling distribution
+ * The cells are evaluated in parallel with batched lookups, then summed in
+ * place into the CDF of m_distrb (see DiscreteDistribution::rebuild), so
+ * repeated calls with the same resolution do not reallocate.
+ */
 void CubeDistribution::set_mass(const Bitmap &radiance) {
-    int width  = m_res[0];
-    int height = m_res[1];
+    const int height = m_res[1];
 
-    int            n      = width * height;
-    Eigen::ArrayXi idx    = Eigen::ArrayXi::LinSpaced(n, 0, n - 1);
-    Eigen::ArrayXi mod    = idx - (idx / height) * height;
-    Eigen::ArrayXd thetas = (mod.cast<Float>() + 0.5) * (M_PI / static_cast<Float>(height));
+    // sin(theta) only depends on the row
+    m_sin_theta.resize(height);
+    for (int y = 0; y < height; ++y)
+        m_sin_theta[y] = sin((y + 0.5) * (M_PI / static_cast<Float>(height)));
 
-    ArrayXd pmf(n);
-    for (int i = 0; i < m_cells.rows(); i++) {
-        Vector2i cell  = m_cells.row(i).matrix();
-        Float    theta = thetas[i];
-        Vector2  uv    = (cell.cast<Float>() + Vector2(0.5, 0.5)).cwiseProduct(m_unit);
-        Spectrum val   = radiance.eval(uv, false);
-        pmf[i]         = rgb2luminance(val) * sin(theta); // NOTE reference
+    m_mass.resize(m_num_cells);
+    eval_mass(radiance, Array2i(0, 0), m_res);
+    build_distrb();
+    m_ready = true;
+}
+
+void CubeDistribution::set_hierarchical(bool hierarchical) {
+    if (hierarchical == m_hierarchical)
+        return;
+    m_hierarchical = hierarchical;
+    // the other representation was never built (or cleared), rebuild it from m_mass
+    if (m_ready)
+        build_distrb();
+}
+
+/// Build the sampling structure of the current mode from m_mass
+void CubeDistribution::build_distrb() {
+    if (m_hierarchical) {
+        m_hdistrb.set_resolution(m_res);
+        m_hdistrb.set_mass(m_mass);
+        m_distrb.clear();
+    } else {
+        m_distrb.rebuild(m_num_cells, [&](size_t i) { return m_mass[i]; });
+        m_hdistrb = HierarchicalDistribution2D();
     }
+}
 
-    m_distrb = DiscreteDistribution(pmf);
+void CubeDistribution::update_mass(const Bitmap &radiance, const Array2i &lo,
+                                   const Array2i &hi) {
+    PSDR_ASSERT(m_ready);
+    Array2i a = lo.max(0), b = hi.min(m_res);
+    eval_mass(radiance, a, b);
 
-    m_ready = true;
+    if (m_hierarchical)
+        m_hdistrb.update_mass(m_mass, a, b);
+    else
+        m_distrb.rebuild(m_num_cells, [&](size_t i) { return m_mass[i]; });
 }
 
 Float CubeDistribution::sample_reuse(Vector2 &samples) const {
     PSDR_ASSERT(m_ready);
+    if (m_hierarchical)
+        return m_hdistrb.sample_reuse(samples);
     Float pdf;
     int   idx = m_distrb.sampleReuse(samples[1], pdf);
     samples += m_cells.row(idx).cast<Float>().matrix();
@@ -67,6 +129,8 @@ Float CubeDistribution::pdf(const Vector2 &p) const {
         printf("warning cube distribution ip: %d %d, res: %d %d", ip[0], ip[1], m_res[0], m_res[1]);
         return 0;
     }
+    if (m_hierarchical)
+        return m_hdistrb.mass(ip[0], ip[1]) / m_hdistrb.sum() * static_cast<Float>(m_num_cells);
     // PSDR_ASSERT(ip[0] >= 0 && ip[0] < m_res[0] && ip[1] >= 0 && ip[1] < m_res[1]);
     int idx = ip[0];
     for (int i = 1; i < 2; ++i) {
@@ -19,7 +19,7 @@ FileStream::FileStream(const fs::path &p, EMode mode)
       m_file(new std::fstream(p, ::ios_flag(mode))) {
 
     if (!m_file->good())
-        Throw("\"%s\": I/O error while attempting to open file: %s",
+        Throw("\"{}\": I/O error while attempting to open file: {}",
               m_path.string(), strerror(errno));
 }
 
@@ -35,10 +35,48 @@ void FileStream::read(void *p, size_t size) {
         size_t gcount = m_file->gcount();
         m_file->clear();
         if (eof)
-            Throw("\"%s\": read %zu out of %zu bytes", m_path.string(), gcount,
+            Throw("\"{}\": read {} out of {} bytes", m_path.string(), gcount,
                   size);
         else
-            Throw("\"%s\": I/O error while attempting to read %zu bytes: %s",
+            Throw("\"{}\": I/O error while attempting to read {} bytes: {}",
                   m_path.string(), size, strerror(errno));
     }
-}
\ No newline at end of file
+}
+
+void FileStream::write(const void *p, size_t size) {
+    if (!can_write())
+        Throw("\"{}\": attempted to write to a read-only file", m_path.string());
+    m_file->write((const char *) p, size);
+
+    if (!m_file->good()) {
+        m_file->clear();
+        Throw("\"{}\": I/O error while attempting to write {} bytes: {}",
+              m_path.string(), size, strerror(errno));
+    }
+}
+
+void FileStream::seek(size_t pos) {
+    // std::fstream keeps a single position for reading and writing
+    m_file->seekg(static_cast<std::streamoff>(pos));
+    if (!m_file->good())
+        Throw("\"{}\": I/O error while attempting to seek to offset {}",
+              m_path.string(), pos);
+}
+
+size_t FileStream::tell() const {
+    std::streamoff pos = m_file->tellg();
+    if (pos == std::streamoff(-1))
+        Throw("\"{}\": I/O error while attempting to determine position in file",
+              m_path.string());
+    return static_cast<size_t>(pos);
+}
+
+size_t FileStream::size() const {
+    size_t pos = tell();
+    m_file->seekg(0, std::ios::end);
+    size_t size = tell();
+    m_file->seekg(static_cast<std::streamoff>(pos));
+    return size;
+}
+
+void FileStream::flush() { m_file->flush(); }
@@ -0,0 +1,101 @@
+#include <core/hierarchical_distrb.h>
+#include <core/logger.h>
+
+/**
+ * \brief Set the resolution of the finest level, need to call set_mass after this
+ * initialize m_res, m_num_cells, m_dims and the (zeroed) levels
+ */
+void HierarchicalDistribution2D::set_resolution(const Array2i &res) {
+    PSDR_ASSERT(res[0] > 0 && res[1] > 0);
+    PSDR_ASSERT((int64_t) res[0] * res[1] < std::numeric_limits<int>::max());
+    m_res       = res;
+    m_num_cells = res[0] * res[1];
+
+    m_dims.clear();
+    m_dims.push_back(res);
+    while (m_dims.back()[0] > 1 || m_dims.back()[1] > 1)
+        m_dims.push_back((m_dims.back() + 1) / 2);
+
+    // every level except the top one is padded to whole 2x2 blocks
+    m_levels.resize(m_dims.size() - 1);
+    for (size_t l = 0; l < m_levels.size(); ++l)
+        m_levels[l] = ArrayXd::Zero(4 * (size_t) m_dims[l + 1].prod());
+    m_sum = 0;
+}
+
+void HierarchicalDistribution2D::set_mass(const ArrayXd &mass) {
+    update_mass(mass, Array2i(0, 0), m_res);
+}
+
+void HierarchicalDistribution2D::update_mass(const ArrayXd &mass,
+                                             const Array2i &lo,
+                                             const Array2i &hi) {
+    PSDR_ASSERT(mass.size() == m_num_cells);
+    Array2i a = lo.max(0), b = hi.min(m_res);
+    if ((a >= b).any())
+        return;
+
+    if (m_levels.empty()) {
+        m_sum = mass[0];
+        return;
+    }
+    for (int x = a[0]; x < b[0]; ++x)
+        for (int y = a[1]; y < b[1]; ++y)
+            m_levels[0][quad_index(0, x, y)] = mass[x * m_res[1] + y];
+    refresh(a, b);
+}
+
+/// Recompute all ancestors of the finest-level cells in [lo, hi)
+void HierarchicalDistribution2D::refresh(Array2i lo, Array2i hi) {
+    for (size_t l = 1; l < m_dims.size(); ++l) {
+        lo = lo / 2;
+        hi = (hi + 1) / 2;
+        if (l == m_levels.size()) {
+            m_sum = child_sum(l - 1, 0, 0);
+            break;
+        }
+        for (int y = lo[1]; y < hi[1]; ++y)
+            for (int x = lo[0]; x < hi[0]; ++x)
+                m_levels[l][quad_index(l, x, y)] = child_sum(l - 1, x, y);
+    }
+    if (!(m_sum > 0) || !std::isfinite(m_sum))
+        PSDR_WARN("HierarchicalDistribution2D: invalid total mass {}", m_sum);
+}
+
+Float HierarchicalDistribution2D::sample_reuse(Vector2 &samples) const {
+    const Float one_minus_eps = 1 - std::numeric_limits<Float>::epsilon();
+    int         x = 0, y = 0;
+    for (int l = (int) m_levels.size() - 1; l >= 0; --l) {
+        const Float *q = m_levels[l].data() + 4 * ((size_t) y * m_dims[l + 1][0] + x);
+
+        // choose the column, then the row within it
+        Float left = q[0] + q[2];
+        Float p    = left / (left + (q[1] + q[3]));
+        int   dx   = samples[0] >= p;
+        samples[0] = dx ? (samples[0] - p) / (1 - p) : samples[0] / p;
+        samples[0] = std::min(samples[0], one_minus_eps);
+
+        Float top = q[dx];
+        p         = top / (top + q[2 + dx]);
+        int dy    = samples[1] >= p;
+        samples[1] = dy ? (samples[1] - p) / (1 - p) : samples[1] / p;
+        samples[1] = std::min(samples[1], one_minus_eps);
+
+        x = 2 * x + dx;
+        y = 2 * y + dy;
+    }
+    samples[0] = (x + samples[0]) / static_cast<Float>(m_res[0]);
+    samples[1] = (y + samples[1]) / static_cast<Float>(m_res[1]);
+    return mass(x, y) / m_sum * static_cast<Float>(m_num_cells);
+}
+
+Float HierarchicalDistribution2D::mass(int x, int y) const {
+    return m_levels.empty() ? m_sum : m_levels[0][quad_index(0, x, y)];
+}
+
+Float HierarchicalDistribution2D::pdf(const Vector2 &p) const {
+    Eigen::Array2i ip = (p.array() * m_res.cast<Float>()).floor().cast<int>();
+    if (!(ip[0] >= 0 && ip[0] < m_res[0] && ip[1] >= 0 && ip[1] < m_res[1]))
+        return 0;
+    return mass(ip[0], ip[1]) / m_sum * static_cast<Float>(m_num_cells);
+}
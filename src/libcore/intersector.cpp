@@ -0,0 +1,213 @@
+#include <core/intersector.h>
+#include <core/logger.h>
+
+#include <embree3/rtcore.h>
+
+namespace {
+/// Rays handed to Embree at once by rayIntersectStream
+constexpr size_t StreamBlock = 256;
+
+void error_callback(void *, RTCError code, const char *str)
+{
+    PSDR_ERROR("Embree: {} (error {})", str ? str : "unknown error", (int) code);
+}
+
+inline void set_ray(RTCRayHit &rh, const Ray &ray)
+{
+    rh.ray.org_x = (float) ray.org.x();
+    rh.ray.org_y = (float) ray.org.y();
+    rh.ray.org_z = (float) ray.org.z();
+    rh.ray.dir_x = (float) ray.dir.x();
+    rh.ray.dir_y = (float) ray.dir.y();
+    rh.ray.dir_z = (float) ray.dir.z();
+    rh.ray.tnear = (float) ray.tmin;
+    rh.ray.tfar = (float) ray.tmax;
+    rh.ray.time = 0;
+    rh.ray.mask = 0xFFFFFFFFu;
+    rh.ray.id = 0;
+    rh.ray.flags = 0;
+    rh.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+    rh.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+}
+
+inline void get_hit(const RTCRayHit &rh, Intersector::Hit &hit)
+{
+    hit = Intersector::Hit();
+    if (rh.hit.geomID != RTC_INVALID_GEOMETRY_ID)
+        hit = Intersector::Hit{ (int) rh.hit.geomID, (int) rh.hit.primID, rh.hit.u, rh.hit.v, rh.ray.tfar };
+}
+
+template <int N>
+struct Packet;
+
+template <>
+struct Packet<4>
+{
+    using RayHit = RTCRayHit4;
+    static void intersect(const int *valid, RTCScene scene, RTCIntersectContext *context, RayHit *rh)
+    {
+        rtcIntersect4(valid, scene, context, rh);
+    }
+};
+
+template <>
+struct Packet<8>
+{
+    using RayHit = RTCRayHit8;
+    static void intersect(const int *valid, RTCScene scene, RTCIntersectContext *context, RayHit *rh)
+    {
+        rtcIntersect8(valid, scene, context, rh);
+    }
+};
+
+template <>
+struct Packet<16>
+{
+    using RayHit = RTCRayHit16;
+    static void intersect(const int *valid, RTCScene scene, RTCIntersectContext *context, RayHit *rh)
+    {
+        rtcIntersect16(valid, scene, context, rh);
+    }
+};
+} // namespace
+
+Intersector::Intersector()
+{
+    m_device = rtcNewDevice(nullptr);
+    if (!m_device)
+        Throw("Intersector: could not create the Embree device (error {})",
+              (int) rtcGetDeviceError(nullptr));
+    rtcSetDeviceErrorFunction(m_device, error_callback, nullptr);
+    m_scene = rtcNewScene(m_device);
+    rtcSetSceneFlags(m_scene, RTC_SCENE_FLAG_ROBUST);
+    rtcSetSceneBuildQuality(m_scene, RTC_BUILD_QUALITY_HIGH);
+}
+
+Intersector::~Intersector()
+{
+    if (m_scene)
+        rtcReleaseScene(m_scene);
+    if (m_device)
+        rtcReleaseDevice(m_device);
+}
+
+int Intersector::addMesh(const std::vector<Vector> &vertices, const std::vector<Vector3i> &faces)
+{
+    RTCGeometry geometry = rtcNewGeometry(m_device, RTC_GEOMETRY_TYPE_TRIANGLE);
+    float *vb = static_cast<float *>(rtcSetNewGeometryBuffer(
+        geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, 3 * sizeof(float), vertices.size()));
+    unsigned *ib = static_cast<unsigned *>(rtcSetNewGeometryBuffer(
+        geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, 3 * sizeof(unsigned), faces.size()));
+    if (!vb || !ib) {
+        rtcReleaseGeometry(geometry);
+        Throw("Intersector: could not allocate the buffers of a mesh with {} vertices and {} faces",
+              vertices.size(), faces.size());
+    }
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+        for (int j = 0; j < 3; ++j)
+            vb[3 * i + j] = (float) vertices[i][j];
+    for (size_t i = 0; i < faces.size(); ++i)
+        for (int j = 0; j < 3; ++j) {
+            PSDR_ASSERT(faces[i][j] >= 0 && faces[i][j] < (int) vertices.size());
+            ib[3 * i + j] = (unsigned) faces[i][j];
+        }
+
+    rtcCommitGeometry(geometry);
+    rtcAttachGeometryByID(m_scene, geometry, (unsigned) m_shapes);
+    rtcReleaseGeometry(geometry);
+    m_committed = false;
+    return m_shapes++;
+}
+
+void Intersector::commit()
+{
+    rtcCommitScene(m_scene);
+    RTCError error = rtcGetDeviceError(m_device);
+    if (error != RTC_ERROR_NONE)
+        Throw("Intersector: could not build the scene (error {})", (int) error);
+    m_committed = true;
+}
+
+bool Intersector::rayIntersect(const Ray &ray, Hit &hit) const
+{
+    assert(m_committed);
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    RTCRayHit rh;
+    set_ray(rh, ray);
+    rtcIntersect1(m_scene, &context, &rh);
+    get_hit(rh, hit);
+    return hit.isValid();
+}
+
+bool Intersector::rayOccluded(const Ray &ray) const
+{
+    assert(m_committed);
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    RTCRayHit rh;
+    set_ray(rh, ray);
+    rtcOccluded1(m_scene, &context, &rh.ray);
+    // tfar is set to -inf on a hit
+    return rh.ray.tfar < 0;
+}
+
+template <int N>
+void Intersector::rayIntersectPacket(const Ray *rays, Hit *hits, const int *valid) const
+{
+    assert(m_committed);
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    alignas(64) int mask[N];
+    typename Packet<N>::RayHit rh;
+    for (int i = 0; i < N; ++i) {
+        mask[i] = (!valid || valid[i]) ? -1 : 0;
+        const Ray &ray = rays[i];
+        rh.ray.org_x[i] = (float) ray.org.x();
+        rh.ray.org_y[i] = (float) ray.org.y();
+        rh.ray.org_z[i] = (float) ray.org.z();
+        rh.ray.dir_x[i] = (float) ray.dir.x();
+        rh.ray.dir_y[i] = (float) ray.dir.y();
+        rh.ray.dir_z[i] = (float) ray.dir.z();
+        rh.ray.tnear[i] = (float) ray.tmin;
+        rh.ray.tfar[i] = (float) ray.tmax;
+        rh.ray.time[i] = 0;
+        rh.ray.mask[i] = 0xFFFFFFFFu;
+        rh.ray.id[i] = 0;
+        rh.ray.flags[i] = 0;
+        rh.hit.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+        rh.hit.instID[0][i] = RTC_INVALID_GEOMETRY_ID;
+    }
+    Packet<N>::intersect(mask, m_scene, &context, &rh);
+    for (int i = 0; i < N; ++i) {
+        hits[i] = Hit();
+        if (mask[i] && rh.hit.geomID[i] != RTC_INVALID_GEOMETRY_ID)
+            hits[i] = Hit{ (int) rh.hit.geomID[i], (int) rh.hit.primID[i], rh.hit.u[i], rh.hit.v[i],
+                           rh.ray.tfar[i] };
+    }
+}
+
+template void Intersector::rayIntersectPacket<4>(const Ray *, Hit *, const int *) const;
+template void Intersector::rayIntersectPacket<8>(const Ray *, Hit *, const int *) const;
+template void Intersector::rayIntersectPacket<16>(const Ray *, Hit *, const int *) const;
+
+void Intersector::rayIntersectStream(const Ray *rays, size_t count, Hit *hits, bool coherent) const
+{
+    assert(m_committed);
+    const int blocks = static_cast<int>((count + StreamBlock - 1) / StreamBlock);
+#pragma omp parallel for schedule(dynamic) if (blocks > 1)
+    for (int b = 0; b < blocks; ++b) {
+        const size_t begin = b * StreamBlock, size = std::min(StreamBlock, count - begin);
+        RTCIntersectContext context;
+        rtcInitIntersectContext(&context);
+        if (coherent)
+            context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+        RTCRayHit rh[StreamBlock];
+        for (size_t i = 0; i < size; ++i)
+            set_ray(rh[i], rays[begin + i]);
+        rtcIntersect1M(m_scene, &context, rh, (unsigned) size, sizeof(RTCRayHit));
+        for (size_t i = 0; i < size; ++i)
+            get_hit(rh[i], hits[begin + i]);
+    }
+}
@@ -0,0 +1,240 @@
+#include <core/mipmap.h>
+#include <core/logger.h>
+
+#include <array>
+#include <cmath>
+#include <sstream>
+
+namespace {
+/// Wrap texel index \c i to [0, n - 1) with the corner-aligned period of Bitmap::eval
+inline int wrap(int i, int n)
+{
+    const int period = n - 1;
+    return period > 0 ? ((i % period) + period) % period : 0;
+}
+
+/// Source texels and tent weights of every destination texel along one axis
+struct Taps
+{
+    int                size;   // taps per destination texel
+    std::vector<int>   first;  // first source texel, per destination texel
+    std::vector<Float> weight; // weights of texels first .. first + size - 1
+};
+
+Taps tent_taps(int src, int dst)
+{
+    // destination texel i sits at source coordinate i * (src - 1) / (dst - 1)
+    const Float step = dst > 1 ? static_cast<Float>(src - 1) / (dst - 1) : 0,
+                radius = std::max(Float(1), step);
+    Taps taps;
+    taps.size = 2 * static_cast<int>(std::ceil(radius)) + 1;
+    taps.first.resize(dst);
+    taps.weight.resize((size_t) taps.size * dst);
+    for (int i = 0; i < dst; ++i) {
+        const Float center = dst > 1 ? i * step : Float(0.5) * (src - 1);
+        const int   first = static_cast<int>(std::ceil(center - radius));
+        Float      *w = &taps.weight[(size_t) taps.size * i];
+        Float       sum = 0;
+        for (int k = 0; k < taps.size; ++k) {
+            w[k] = std::max(Float(0), 1 - std::abs(first + k - center) / radius);
+            sum += w[k];
+        }
+        for (int k = 0; k < taps.size; ++k)
+            w[k] /= sum;
+        taps.first[i] = first;
+    }
+    return taps;
+}
+
+/// Resample \c src at half resolution with a tent of one destination texel radius
+void downsample(const Bitmap &src, Bitmap &dst)
+{
+    const Vector2i &res = src.m_res;
+    dst.m_format = src.m_format;
+    dst.m_layout = src.m_layout;
+    dst.resize(Vector2i(((res.array() + 1) / 2).max(1)));
+
+    const int  width = dst.width(), height = dst.height();
+    const Taps tx = tent_taps(res.x(), width), ty = tent_taps(res.y(), height);
+#pragma omp parallel for if ((int64_t) width * height > (1 << 14))
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            Spectrum sum = Spectrum::Zero();
+            for (int j = 0; j < ty.size; ++j) {
+                Float wy = ty.weight[(size_t) ty.size * y + j];
+                if (wy == 0)
+                    continue;
+                int sy = wrap(ty.first[y] + j, res.y());
+                for (int i = 0; i < tx.size; ++i) {
+                    Float wx = tx.weight[(size_t) tx.size * x + i];
+                    if (wx == 0)
+                        continue;
+                    int sx = wrap(tx.first[x] + i, res.x());
+                    sum += wx * wy * src.texel((size_t) sy * res.x() + sx);
+                }
+            }
+            dst.setTexel((size_t) y * width + x, sum);
+        }
+}
+
+/// Gaussian EWA filter exp(-alpha r^2) - exp(-alpha), tabulated over r^2 in [0, 1]
+const std::array<Float, 128> &ewa_weights()
+{
+    static const std::array<Float, 128> lut = [] {
+        std::array<Float, 128> t;
+        const Float alpha = 2;
+        for (size_t i = 0; i < t.size(); ++i) {
+            Float r2 = static_cast<Float>(i) / (t.size() - 1);
+            t[i] = std::exp(-alpha * r2) - std::exp(-alpha);
+        }
+        return t;
+    }();
+    return lut;
+}
+
+/// Number of texel intervals along the longer side of level 0
+inline Float intervals(const Bitmap &bitmap)
+{
+    return static_cast<Float>(std::max(bitmap.m_res.maxCoeff() - 1, 1));
+}
+} // namespace
+
+MIPMap::MIPMap(Bitmap bitmap)
+{
+    m_levels.push_back(std::move(bitmap));
+    init();
+}
+
+MIPMap::MIPMap(const char *filename, Bitmap::StorageFormat format)
+{
+    m_levels.emplace_back(filename, format);
+    init();
+}
+
+void MIPMap::init()
+{
+    PSDR_ASSERT((m_levels[0].m_res.array() > 0).all());
+    Vector2i res = m_levels[0].m_res;
+    while (res.x() > 1 || res.y() > 1) {
+        res = ((res.array() + 1) / 2).max(1);
+        m_levels.emplace_back();
+    }
+    m_built.reset(new std::once_flag[m_levels.size()]);
+}
+
+void MIPMap::build()
+{
+    for (int l = 1; l < levels(); ++l)
+        level(l);
+}
+
+const Bitmap &MIPMap::level(int l) const
+{
+    PSDR_ASSERT(l >= 0 && l < levels());
+    if (l > 0)
+        std::call_once(m_built[l], [&] { downsample(level(l - 1), m_levels[l]); });
+    return m_levels[l];
+}
+
+Spectrum MIPMap::evalTrilinear(const Vector2 &uv, Float width, bool flip_v) const
+{
+    Float lod = std::log2(std::max(width * intervals(m_levels[0]), Float(1e-8)));
+    if (lod <= 0)
+        return m_levels[0].eval(uv, flip_v);
+    if (lod >= levels() - 1)
+        return level(levels() - 1).eval(uv, flip_v);
+    int   l = static_cast<int>(lod);
+    Float t = lod - l;
+    return (1 - t) * level(l).eval(uv, flip_v) + t * level(l + 1).eval(uv, flip_v);
+}
+
+Spectrum MIPMap::evalEWA(const Vector2 &_uv, const Vector2 &duvdx, const Vector2 &duvdy,
+                         bool flip_v, Float max_anisotropy) const
+{
+    Array2  uv = _uv.array();
+    Vector2 axis0 = duvdx, axis1 = duvdy;
+    if (flip_v) {
+        uv.y() = -uv.y();
+        axis0.y() = -axis0.y();
+        axis1.y() = -axis1.y();
+    }
+    uv -= uv.floor();
+
+    if (axis0.squaredNorm() < axis1.squaredNorm())
+        std::swap(axis0, axis1);
+    Float major = axis0.norm(), minor = axis1.norm();
+    // clamp the eccentricity, the filter would otherwise cover too many texels
+    if (minor * max_anisotropy < major && minor > 0) {
+        Float scale = major / (minor * max_anisotropy);
+        axis1 *= scale;
+        minor *= scale;
+    }
+    if (minor == 0)
+        return m_levels[0].eval(uv.matrix(), false);
+
+    Float lod = std::max(Float(0), std::log2(minor * intervals(m_levels[0])));
+    int   l = static_cast<int>(lod);
+    if (l >= levels() - 1)
+        return ewa(levels() - 1, uv, axis0, axis1);
+    Float t = lod - l;
+    return (1 - t) * ewa(l, uv, axis0, axis1) + t * ewa(l + 1, uv, axis0, axis1);
+}
+
+Spectrum MIPMap::ewa(int l, Array2 uv, Vector2 axis0, Vector2 axis1) const
+{
+    const Bitmap &bitmap = level(l);
+    const int width = bitmap.width(), height = bitmap.height();
+    if (width == 1 && height == 1)
+        return bitmap.texel(0);
+
+    // texel space of this level
+    Array2 scale = (bitmap.m_res.array() - 1).max(0).cast<Float>();
+    Array2 st = uv * scale;
+    axis0 = axis0.cwiseProduct(scale.matrix());
+    axis1 = axis1.cwiseProduct(scale.matrix());
+
+    // implicit ellipse A s^2 + B s t + C t^2 < 1, widened by one texel
+    Float A = axis0.y() * axis0.y() + axis1.y() * axis1.y() + 1;
+    Float B = -2 * (axis0.x() * axis0.y() + axis1.x() * axis1.y());
+    Float C = axis0.x() * axis0.x() + axis1.x() * axis1.x() + 1;
+    Float invF = 1 / (A * C - B * B * 0.25);
+    A *= invF;
+    B *= invF;
+    C *= invF;
+
+    // bounding box of the ellipse
+    Float det = -B * B + 4 * A * C, invDet = 1 / det;
+    Float uSqrt = std::sqrt(det * C), vSqrt = std::sqrt(A * det);
+    int s0 = static_cast<int>(std::ceil(st.x() - 2 * invDet * uSqrt)),
+        s1 = static_cast<int>(std::floor(st.x() + 2 * invDet * uSqrt)),
+        t0 = static_cast<int>(std::ceil(st.y() - 2 * invDet * vSqrt)),
+        t1 = static_cast<int>(std::floor(st.y() + 2 * invDet * vSqrt));
+
+    const auto &lut = ewa_weights();
+    Spectrum sum = Spectrum::Zero();
+    Float sum_weights = 0;
+    for (int it = t0; it <= t1; ++it) {
+        Float tt = it - st.y();
+        int   y = wrap(it, height);
+        for (int is = s0; is <= s1; ++is) {
+            Float ss = is - st.x();
+            Float r2 = A * ss * ss + B * ss * tt + C * tt * tt;
+            if (r2 < 1) {
+                int   x = wrap(is, width);
+                Float weight = lut[std::min(static_cast<size_t>(r2 * lut.size()), lut.size() - 1)];
+                sum += weight * bitmap.texel((size_t) y * width + x);
+                sum_weights += weight;
+            }
+        }
+    }
+    if (!(sum_weights > 0))
+        return bitmap.eval(uv.matrix(), false);
+    return sum / sum_weights;
+}
+
+std::string MIPMap::toString() const
+{
+    std::stringstream ss;
+    ss << "MIPMap[" << m_levels[0].m_res.transpose() << ", levels=" << levels() << "]";
+    return ss.str();
+}
@@ -0,0 +1,89 @@
+#include <core/mmstream.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MemoryMappedStream::MemoryMappedStream(const fs::path &p, FileStream::EMode mode)
+    : Stream(), m_mode(mode), m_path(p) {
+    int flags = mode == FileStream::ERead ? O_RDONLY
+              : mode == FileStream::EReadWrite ? O_RDWR
+                                               : O_RDWR | O_CREAT | O_TRUNC;
+    m_fd = ::open(p.c_str(), flags, 0644);
+    if (m_fd < 0)
+        Throw("\"{}\": I/O error while attempting to open file: {}", m_path.string(),
+              strerror(errno));
+
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) {
+        ::close(m_fd);
+        Throw("\"{}\": I/O error while attempting to determine the file size: {}",
+              m_path.string(), strerror(errno));
+    }
+    m_size = m_capacity = static_cast<size_t>(st.st_size);
+    if (m_capacity == 0)
+        return; // mmap() rejects empty mappings, map on the first write
+
+    int   prot = can_write() ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *ptr  = mmap(nullptr, m_capacity, prot, MAP_SHARED, m_fd, 0);
+    if (ptr == MAP_FAILED) {
+        ::close(m_fd);
+        Throw("\"{}\": could not map file: {}", m_path.string(), strerror(errno));
+    }
+    m_data = static_cast<uint8_t *>(ptr);
+}
+
+MemoryMappedStream::~MemoryMappedStream() { close(); }
+
+void MemoryMappedStream::close() {
+    if (m_fd < 0)
+        return;
+    if (m_data)
+        munmap(m_data, m_capacity);
+    if (can_write() && m_capacity != m_size && ftruncate(m_fd, m_size) != 0)
+        PSDR_WARN("\"{}\": could not truncate file: {}", m_path.string(), strerror(errno));
+    ::close(m_fd);
+    m_fd   = -1;
+    m_data = nullptr;
+}
+
+void MemoryMappedStream::reserve(size_t size) {
+    if (size <= m_capacity)
+        return;
+    size_t capacity = std::max(size, 2 * m_capacity);
+    if (ftruncate(m_fd, capacity) != 0)
+        Throw("\"{}\": could not grow file to {} bytes: {}", m_path.string(), capacity,
+              strerror(errno));
+    void *ptr = m_data ? mremap(m_data, m_capacity, capacity, MREMAP_MAYMOVE)
+                       : mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (ptr == MAP_FAILED)
+        Throw("\"{}\": could not map {} bytes: {}", m_path.string(), capacity, strerror(errno));
+    m_data     = static_cast<uint8_t *>(ptr);
+    m_capacity = capacity;
+}
+
+void MemoryMappedStream::read(void *p, size_t size) {
+    if (m_pos + size > m_size) {
+        size_t avail = m_pos < m_size ? m_size - m_pos : 0;
+        Throw("\"{}\": read {} out of {} bytes", m_path.string(), avail, size);
+    }
+    memcpy(p, m_data + m_pos, size);
+    m_pos += size;
+}
+
+void MemoryMappedStream::write(const void *p, size_t size) {
+    if (!can_write())
+        Throw("\"{}\": attempted to write to a read-only file", m_path.string());
+    reserve(m_pos + size);
+    memcpy(m_data + m_pos, p, size);
+    m_pos += size;
+    m_size = std::max(m_size, m_pos);
+}
+
+void MemoryMappedStream::seek(size_t pos) { m_pos = pos; }
+
+void MemoryMappedStream::flush() {
+    if (m_data && can_write() && msync(m_data, m_capacity, MS_ASYNC) != 0)
+        Throw("\"{}\": msync failed: {}", m_path.string(), strerror(errno));
+}
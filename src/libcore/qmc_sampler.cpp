@@ -0,0 +1,314 @@
+#include <core/qmc_sampler.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr Float OneMinusEpsilon = Float(1) - std::numeric_limits<Float>::epsilon() / 2;
+
+inline uint64_t mix_bits(uint64_t v) {
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185ULL;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44dULL;
+    v ^= (v >> 33);
+    return v;
+}
+
+inline uint64_t hash(uint64_t a, uint64_t b) {
+    return mix_bits(a ^ mix_bits(b + 0x9e3779b97f4a7c15ULL));
+}
+
+/// Map 32 bits to [0, 1)
+inline Float to_unit(uint32_t x) {
+    return std::min(static_cast<Float>(x) * static_cast<Float>(0x1p-32), OneMinusEpsilon);
+}
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Burley 2020, "Practical Hash-based Owen Scrambling"
+inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x = laine_karras_permutation(x, seed);
+    return reverse_bits(x);
+}
+
+// Kensler 2013, "Correlated Multi-Jittered Sampling": element i of a
+// random permutation of [0, l)
+inline uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+    uint32_t w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= p;
+        i *= 0xe170893d;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;
+        i *= 0x0929eb3f;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | p >> 27;
+        i *= 0x6935fa69;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3df;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= l);
+    return (i + p) % l;
+}
+
+/**
+ * Generator matrices of the first Sobol' dimensions, column k is stored
+ * in v[dim][k]. Dimension 0 is the van der Corput sequence, the others use
+ * the primitive polynomials and initial direction numbers of Joe and Kuo.
+ */
+struct SobolMatrices {
+    uint32_t v[SobolSampler::Dimensions][32];
+};
+
+constexpr SobolMatrices make_sobol_matrices() {
+    SobolMatrices t{};
+    const uint32_t s[SobolSampler::Dimensions]    = { 0, 1, 2, 3 };
+    const uint32_t a[SobolSampler::Dimensions]    = { 0, 0, 1, 1 };
+    const uint32_t m[SobolSampler::Dimensions][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 3, 0 }, { 1, 3, 1 } };
+    for (int k = 0; k < 32; ++k)
+        t.v[0][k] = 1u << (31 - k);
+    for (int d = 1; d < SobolSampler::Dimensions; ++d) {
+        for (uint32_t k = 0; k < 32; ++k) {
+            if (k < s[d]) {
+                t.v[d][k] = m[d][k] << (31 - k);
+                continue;
+            }
+            uint32_t v = t.v[d][k - s[d]] ^ (t.v[d][k - s[d]] >> s[d]);
+            for (uint32_t j = 1; j < s[d]; ++j)
+                if ((a[d] >> (s[d] - 1 - j)) & 1)
+                    v ^= t.v[d][k - j];
+            t.v[d][k] = v;
+        }
+    }
+    return t;
+}
+
+constexpr SobolMatrices sobol_matrices = make_sobol_matrices();
+
+struct PrimeTable {
+    uint32_t p[HaltonSampler::Dimensions];
+};
+
+constexpr PrimeTable make_prime_table() {
+    PrimeTable t{};
+    int n = 0;
+    for (uint32_t c = 2; n < HaltonSampler::Dimensions; ++c) {
+        bool prime = true;
+        for (int i = 0; i < n && t.p[i] * t.p[i] <= c; ++i)
+            if (c % t.p[i] == 0) {
+                prime = false;
+                break;
+            }
+        if (prime)
+            t.p[n++] = c;
+    }
+    return t;
+}
+
+constexpr PrimeTable primes = make_prime_table();
+
+inline Float radical_inverse(uint32_t base, uint64_t a) {
+    const Float inv_base = Float(1) / base;
+    uint64_t    reversed = 0;
+    Float       inv_base_n = 1;
+    while (a) {
+        uint64_t next  = a / base;
+        uint64_t digit = a - next * base;
+        reversed   = reversed * base + digit;
+        inv_base_n *= inv_base;
+        a = next;
+    }
+    return std::min(reversed * inv_base_n, OneMinusEpsilon);
+}
+} // namespace
+
+// -----------------------------------------------------------------------------
+//  SobolSampler
+// -----------------------------------------------------------------------------
+
+SobolSampler::SobolSampler(uint64_t seed, int idx, uint32_t sample_index)
+    : m_seed(hash(seed, idx)), m_index(sample_index), m_dim(0), m_saved_dim(0) {}
+
+void SobolSampler::set_sample_index(uint32_t sample_index) {
+    m_index = sample_index;
+    m_dim   = 0;
+}
+
+uint32_t SobolSampler::sobol(uint32_t index, int dim) {
+    uint32_t x = 0;
+    for (int k = 0; index; index >>= 1, ++k)
+        if (index & 1)
+            x ^= sobol_matrices.v[dim][k];
+    return x;
+}
+
+void SobolSampler::enumerate(int dim, uint32_t count, Float *out) {
+    uint32_t x = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        out[i] = to_unit(x);
+        // Gray code: i + 1 differs from i in bit ctz(i + 1)
+        x ^= sobol_matrices.v[dim][__builtin_ctz(i + 1)];
+    }
+}
+
+Float SobolSampler::next1D() {
+    uint32_t dim     = m_dim++;
+    uint64_t pattern = hash(m_seed, dim / Dimensions);
+    // shuffle the sample order of every pattern, then scramble the point
+    uint32_t index = nested_uniform_scramble(m_index, static_cast<uint32_t>(pattern));
+    uint32_t x     = sobol(index, dim % Dimensions);
+    return to_unit(nested_uniform_scramble(
+        x, static_cast<uint32_t>(hash(pattern, dim % Dimensions))));
+}
+
+Array2 SobolSampler::next2D() {
+    Float x = next1D();
+    return Array2(x, next1D());
+}
+
+Array3 SobolSampler::next3D() {
+    Float x = next1D(), y = next1D();
+    return Array3(x, y, next1D());
+}
+
+Array4 SobolSampler::next4D() {
+    Float x = next1D(), y = next1D(), z = next1D();
+    return Array4(x, y, z, next1D());
+}
+
+void SobolSampler::sampleRndSeries(Float *series, int N) {
+    for (int i = 0; i < N; i++)
+        series[i] = next1D();
+}
+
+void SobolSampler::save() { m_saved_dim = m_dim; }
+void SobolSampler::restore() { m_dim = m_saved_dim; }
+
+// -----------------------------------------------------------------------------
+//  HaltonSampler
+// -----------------------------------------------------------------------------
+
+HaltonSampler::HaltonSampler(uint64_t seed, int idx, uint32_t sample_index)
+    : m_seed(hash(seed, idx)), m_index(sample_index), m_dim(0), m_saved_dim(0) {}
+
+void HaltonSampler::set_sample_index(uint32_t sample_index) {
+    m_index = sample_index;
+    m_dim   = 0;
+}
+
+Float HaltonSampler::next1D() {
+    uint32_t dim   = m_dim++;
+    uint64_t h     = hash(m_seed, dim);
+    if (dim >= (uint32_t) Dimensions)
+        return to_unit(static_cast<uint32_t>(hash(h, m_index)));
+    Float x = radical_inverse(primes.p[dim], m_index) + to_unit(static_cast<uint32_t>(h));
+    return x >= 1 ? std::min(x - 1, OneMinusEpsilon) : x;
+}
+
+Array2 HaltonSampler::next2D() {
+    Float x = next1D();
+    return Array2(x, next1D());
+}
+
+Array3 HaltonSampler::next3D() {
+    Float x = next1D(), y = next1D();
+    return Array3(x, y, next1D());
+}
+
+Array4 HaltonSampler::next4D() {
+    Float x = next1D(), y = next1D(), z = next1D();
+    return Array4(x, y, z, next1D());
+}
+
+void HaltonSampler::sampleRndSeries(Float *series, int N) {
+    for (int i = 0; i < N; i++)
+        series[i] = next1D();
+}
+
+void HaltonSampler::save() { m_saved_dim = m_dim; }
+void HaltonSampler::restore() { m_dim = m_saved_dim; }
+
+// -----------------------------------------------------------------------------
+//  StratifiedSampler
+// -----------------------------------------------------------------------------
+
+StratifiedSampler::StratifiedSampler(uint64_t seed, int idx,
+                                     uint32_t sample_index, uint32_t spp)
+    : m_seed(hash(seed, idx)), m_index(sample_index), m_spp(std::max(spp, 1u)),
+      m_dim(0), m_saved_dim(0) {}
+
+void StratifiedSampler::set_sample_index(uint32_t sample_index) {
+    m_index = sample_index;
+    m_dim   = 0;
+}
+
+Float StratifiedSampler::next1D() {
+    uint64_t h       = hash(m_seed, m_dim++);
+    uint32_t stratum = permute(m_index % m_spp, m_spp, static_cast<uint32_t>(h));
+    Float    jitter  = to_unit(static_cast<uint32_t>(hash(h, m_index)));
+    return (stratum + jitter) / m_spp;
+}
+
+Array2 StratifiedSampler::next2D() {
+    uint64_t h = hash(m_seed, m_dim);
+    m_dim += 2;
+    uint32_t n       = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(m_spp))));
+    uint32_t stratum = permute(m_index % (n * n), n * n, static_cast<uint32_t>(h));
+    uint64_t jitter  = hash(h, m_index);
+    return Array2((stratum % n + to_unit(static_cast<uint32_t>(jitter))) / n,
+                  (stratum / n + to_unit(static_cast<uint32_t>(jitter >> 32))) / n);
+}
+
+Array3 StratifiedSampler::next3D() {
+    Array2 xy = next2D();
+    return Array3(xy.x(), xy.y(), next1D());
+}
+
+Array4 StratifiedSampler::next4D() {
+    Array2 xy = next2D();
+    Array2 zw = next2D();
+    return Array4(xy.x(), xy.y(), zw.x(), zw.y());
+}
+
+void StratifiedSampler::sampleRndSeries(Float *series, int N) {
+    int i = 0;
+    for (; i + 2 <= N; i += 2) {
+        Array2 xy     = next2D();
+        series[i]     = xy.x();
+        series[i + 1] = xy.y();
+    }
+    if (i < N)
+        series[i] = next1D();
+}
+
+void StratifiedSampler::save() { m_saved_dim = m_dim; }
+void StratifiedSampler::restore() { m_dim = m_saved_dim; }
@@ -1,4 +1,71 @@
 #include <core/sampler.h>
+#include <cstring>
+
+namespace {
+constexpr uint64_t PCG32_MULT = 6364136223846793005ULL;
+
+/**
+ * Jump table for RndSampler::Lanes consecutive PCG steps: after k steps the
+ * state is mult[k] * state + scale[k] * inc. This lets all lanes of a block
+ * be computed independently (and vectorized) while producing exactly the
+ * same sequence as repeated next_pcg32() calls.
+ */
+struct PCGLaneTable {
+    uint64_t mult[RndSampler::Lanes + 1];
+    uint64_t scale[RndSampler::Lanes + 1];
+};
+
+constexpr PCGLaneTable make_lane_table() {
+    PCGLaneTable t{};
+    t.mult[0]  = 1;
+    t.scale[0] = 0;
+    for (int k = 0; k < RndSampler::Lanes; ++k) {
+        t.mult[k + 1]  = t.mult[k] * PCG32_MULT;
+        t.scale[k + 1] = t.scale[k] * PCG32_MULT + 1;
+    }
+    return t;
+}
+
+constexpr PCGLaneTable lane_table = make_lane_table();
+
+inline uint32_t pcg32_output(uint64_t oldstate) {
+    // Calculate output function (XSH RR)
+    uint32_t xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
+    uint32_t rot = oldstate >> 59u;
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+/// Map 32 random bits to [0, 1), same as RndSampler::next1D()
+inline double to_unit(uint32_t bits, double) {
+    uint64_t u = ((uint64_t) bits << 20) | 0x3ff0000000000000ULL;
+    double   d;
+    memcpy(&d, &u, sizeof(d));
+    return d - 1.0;
+}
+
+inline float to_unit(uint32_t bits, float) {
+    uint32_t u = (bits >> 9) | 0x3f800000u;
+    float    f;
+    memcpy(&f, &u, sizeof(f));
+    return f - 1.0f;
+}
+
+/// Fill \c series with N uniform samples, RndSampler::Lanes at a time
+template <typename T>
+void fill_series(RndSampler &sampler, T *series, int N) {
+    const uint64_t c = sampler.inc | 1;
+    int i = 0;
+    for (; i + RndSampler::Lanes <= N; i += RndSampler::Lanes) {
+        const uint64_t s = sampler.state;
+#pragma omp simd
+        for (int k = 0; k < RndSampler::Lanes; ++k)
+            series[i + k] = to_unit(pcg32_output(lane_table.mult[k] * s + lane_table.scale[k] * c), T());
+        sampler.state = lane_table.mult[RndSampler::Lanes] * s + lane_table.scale[RndSampler::Lanes] * c;
+    }
+    for (; i < N; ++i)
+        series[i] = to_unit(sampler.next_pcg32(), T());
+}
+} // namespace
 
 RndSampler::RndSampler(uint64_t seed, int idx) {
     state = 0U;
@@ -11,63 +78,96 @@ RndSampler::RndSampler(uint64_t seed, int idx) {
 uint32_t RndSampler::next_pcg32() {
     uint64_t oldstate = state;
     // Advance internal state
-    state = oldstate * 6364136223846793005ULL + (inc|1);
+    state = oldstate * PCG32_MULT + (inc|1);
     // Calculate output function (XSH RR), uses old state for max ILP
-    uint32_t xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
-    uint32_t rot = oldstate >> 59u;
-    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    return pcg32_output(oldstate);
+}
+
+void RndSampler::next_pcg32(uint32_t *out, int N) {
+    const uint64_t c = inc | 1;
+    int i = 0;
+    for (; i + Lanes <= N; i += Lanes) {
+        const uint64_t s = state;
+#pragma omp simd
+        for (int k = 0; k < Lanes; ++k)
+            out[i + k] = pcg32_output(lane_table.mult[k] * s + lane_table.scale[k] * c);
+        state = lane_table.mult[Lanes] * s + lane_table.scale[Lanes] * c;
+    }
+    for (; i < N; ++i)
+        out[i] = next_pcg32();
 }
 
 Float RndSampler::next1D() {
-#ifdef DOUBLE_PRECISION
-    union {
-        uint64_t u;
-        double d;
-    } x;
-    x.u = ((uint64_t) next_pcg32() << 20) | 0x3ff0000000000000ULL;
-    return x.d - 1.0;
-#else
-    union {
-        uint32_t u;
-        float f;
-    } x;
-    x.u = (next_pcg32() >> 9) | 0x3f800000u;
-    return x.f - 1.0f;
-#endif
+    return to_unit(next_pcg32(), Float());
+}
+
+Array2 RndSampler::next2D() {
+    Float rnd[2];
+    sampleRndSeries(rnd, 2);
+    return Array2(rnd[0], rnd[1]);
+}
+
+Array3 RndSampler::next3D() {
+    Float rnd[3];
+    sampleRndSeries(rnd, 3);
+    return Array3(rnd[0], rnd[1], rnd[2]);
 }
 
-Array2 RndSampler::next2D() { return Array2(next1D(), next1D());}
-Array3 RndSampler::next3D() { return Array3(next1D(), next1D(), next1D());}
-Array4 RndSampler::next4D() { return Array4(next1D(), next1D(), next1D(), next1D());}
+Array4 RndSampler::next4D() {
+    Float rnd[4];
+    sampleRndSeries(rnd, 4);
+    return Array4(rnd[0], rnd[1], rnd[2], rnd[3]);
+}
 
 void RndSampler::sampleRndSeries(Float* series, int N) {
+    fill_series(*this, series, N);
+}
+
 #ifdef DOUBLE_PRECISION
-    union {
-        uint64_t u;
-        double d;
-    } x;
-    for (int i = 0; i < N; i++) {
-        x.u = ((uint64_t) next_pcg32() << 20) | 0x3ff0000000000000ULL;
-        series[i] = x.d - 1.0;
-    }
-#else
-    union {
-        uint32_t u;
-        float f;
-    } x;
-
-    for (int i = 0; i < N; i++) {
-        x.u = (next_pcg32() >> 9) | 0x3f800000u;
-        series[i] = x.f - 1.0f;
-    }
+void RndSampler::sampleRndSeries(float* series, int N) {
+    fill_series(*this, series, N);
+}
 #endif
+
+void RndSampler::advance(uint64_t delta) {
+    // Brown, "Random Number Generation with Arbitrary Stride": square the
+    // LCG step while walking over the bits of delta, O(log delta)
+    uint64_t cur_mult = PCG32_MULT, cur_plus = inc | 1;
+    uint64_t acc_mult = 1u, acc_plus = 0u;
+    while (delta > 0) {
+        if (delta & 1) {
+            acc_mult *= cur_mult;
+            acc_plus = acc_plus * cur_mult + cur_plus;
+        }
+        cur_plus = (cur_mult + 1) * cur_plus;
+        cur_mult *= cur_mult;
+        delta /= 2;
+    }
+    state = acc_mult * state + acc_plus;
+}
+
+RndSampler RndSampler::split() {
+    uint32_t rnd[4];
+    next_pcg32(rnd, 4);
+    uint64_t seed   = ((uint64_t) rnd[0] << 32) | rnd[1];
+    uint64_t stream = ((uint64_t) rnd[2] << 32) | rnd[3];
+    // seed the child the same way as the constructor does
+    RndSampler ret(*this);
+    ret.state = 0U;
+    ret.inc   = (stream << 1u) | 1u;
+    ret.next_pcg32();
+    ret.state += seed;
+    ret.next_pcg32();
+    return ret;
 }
 
 void RndSampler::save()
 {
     saved = state;
+    saved_inc = inc;
 }
 void RndSampler::restore()
 {
     state = saved;
+    inc = saved_inc;
 }
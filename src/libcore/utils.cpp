@@ -353,19 +353,10 @@ Vector squareToEdgeRayDirection(const Vector2 &sample, const Vector &n0,
 }
 
 // Convert std::vector<Spectrum> to ArrayXd
+// (a single bulk copy, the layouts are identical)
 ArrayXd from_spectrum_list_to_tensor(const std::vector<Spectrum> &spec_list, int n_pixels)
 {
-    ArrayXd arr = ArrayXd::Zero(n_pixels * 3);
-
-    for (int i = 0; i < n_pixels; ++i)
-    {
-        Eigen::Array3d s = spec_list[i].array();
-        arr[3 * i + 0] = s[0];
-        arr[3 * i + 1] = s[1];
-        arr[3 * i + 2] = s[2];
-    }
-
-    return arr;
+    return spectrum_list_as_tensor(spec_list, n_pixels).cast<double>();
 }
 
 // template <class T>
@@ -382,16 +373,17 @@ ArrayXd from_spectrum_list_to_tensor(const std::vector<Spectrum> &spec_list, int
 std::vector<Spectrum> from_tensor_to_spectrum_list(const ArrayXd &arr, int n_pixels)
 {
     std::vector<Spectrum> spec_list;
-    spec_list.reserve(n_pixels);
-
-    for (int i = 0; i < n_pixels; ++i)
-    {
-        spec_list.push_back(Spectrum(arr(3 * i), arr(3 * i + 1), arr(3 * i + 2)));
-    }
-
+    from_tensor_to_spectrum_list(arr, n_pixels, spec_list);
     return spec_list;
 }
 
+void from_tensor_to_spectrum_list(const ArrayXd &arr, int n_pixels, std::vector<Spectrum> &spec_list)
+{
+    assert(arr.size() >= 3 * (Eigen::Index) n_pixels);
+    spec_list.resize(n_pixels);
+    spectrum_list_as_tensor(spec_list, n_pixels) = arr.head(3 * (Eigen::Index) n_pixels).cast<Float>();
+}
+
 INACTIVE_FN(squareToCosineHemisphere, squareToCosineHemisphere);
 INACTIVE_FN(squareToCosineHemispherePdf, squareToCosineHemispherePdf);
 INACTIVE_FN(detach_Float, detach<Float>);
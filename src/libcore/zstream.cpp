@@ -0,0 +1,304 @@
+#include <core/zstream.h>
+#include <core/miniz.h>
+
+#include <omp.h>
+#include <vector>
+
+namespace {
+constexpr size_t BufferSize = 32768;
+} // namespace
+
+struct ZStream::State {
+    mz_stream deflate_stream, inflate_stream;
+    bool      deflate_init = false, inflate_init = false;
+    bool      inflate_done = false; // the end of the zlib stream has been reached
+    bool      closed       = false;
+    int       level;
+    size_t    pos = 0;
+    std::vector<uint8_t> buffer = std::vector<uint8_t>(BufferSize);
+
+    // chunk-parallel mode
+    size_t               chunk = 0;
+    std::vector<uint8_t> batch;  // pending uncompressed data
+    size_t               batch_size = 0;
+    mz_ulong             adler = MZ_ADLER32_INIT;
+    bool                 header_written = false;
+};
+
+ZStream::ZStream(Stream &child, EMode mode, int level, size_t parallel_chunk)
+    : Stream(), m_child(child), m_mode(mode), m_state(new State) {
+    PSDR_ASSERT_MSG(level >= 0 && level <= 9, "ZStream: invalid compression level {}", level);
+    if (mode == EDeflate && !child.can_write())
+        Throw("ZStream: the child stream of a compressing stream must be writable");
+    if (mode == EInflate && !child.can_read())
+        Throw("ZStream: the child stream of a decompressing stream must be readable");
+    m_state->level = level;
+    m_state->chunk = parallel_chunk;
+    if (parallel_chunk > 0) {
+        m_state->batch_size = parallel_chunk * std::max(omp_get_max_threads(), 1);
+        m_state->batch.reserve(m_state->batch_size);
+    }
+}
+
+ZStream::~ZStream() {
+    try {
+        close();
+    } catch (const std::exception &e) {
+        PSDR_ERROR("ZStream: close() failed in the destructor: {}", e.what());
+    }
+}
+
+void ZStream::close() {
+    State &s = *m_state;
+    if (s.closed)
+        return;
+    s.closed = true;
+    if (m_mode == EDeflate) {
+        // even if nothing was written, emit a valid (empty) zlib stream
+        if (s.chunk > 0) {
+            write_header();
+            compress_batch(true);
+        } else {
+            init_deflate();
+            s.deflate_init = false;
+            deflate_buffer(nullptr, 0, MZ_FINISH);
+            mz_deflateEnd(&s.deflate_stream);
+        }
+    } else {
+        // skip the rest of the compressed data, even if nothing was read
+        init_inflate();
+        s.inflate_init = false;
+        finish_inflate();
+        mz_inflateEnd(&s.inflate_stream);
+    }
+}
+
+void ZStream::init_deflate() {
+    State &s = *m_state;
+    if (s.deflate_init)
+        return;
+    memset(&s.deflate_stream, 0, sizeof(s.deflate_stream));
+    if (mz_deflateInit(&s.deflate_stream, s.level) != MZ_OK)
+        Throw("ZStream: could not initialize the compressor");
+    s.deflate_init = true;
+}
+
+void ZStream::init_inflate() {
+    State &s = *m_state;
+    if (s.inflate_init)
+        return;
+    memset(&s.inflate_stream, 0, sizeof(s.inflate_stream));
+    if (mz_inflateInit(&s.inflate_stream) != MZ_OK)
+        Throw("ZStream: could not initialize the decompressor");
+    s.inflate_init = true;
+}
+
+/// Chunk-parallel mode: zlib header of the stream
+void ZStream::write_header() {
+    State &s = *m_state;
+    if (s.header_written)
+        return;
+    const uint8_t header[2] = { 0x78, 0x9c }; // deflate, 32K window, default level
+    m_child.write(header, 2);
+    s.header_written = true;
+}
+
+/// Refill the input buffer of the decompressor from the child, false at the end of the child
+bool ZStream::refill() {
+    State &s = *m_state;
+    size_t n = std::min(m_child.size() - m_child.tell(), s.buffer.size());
+    if (n == 0)
+        return false;
+    m_child.read(s.buffer.data(), n);
+    s.inflate_stream.next_in  = s.buffer.data();
+    s.inflate_stream.avail_in = static_cast<unsigned int>(n);
+    return true;
+}
+
+/// At the end of the zlib stream, hand the input read past it back to the child
+void ZStream::end_inflate() {
+    State &s = *m_state;
+    mz_stream &z = s.inflate_stream;
+    if (z.avail_in > 0)
+        m_child.seek(m_child.tell() - z.avail_in);
+    z.avail_in     = 0;
+    s.inflate_done = true;
+}
+
+/**
+ * Consume the rest of the zlib stream (typically just the trailer) after
+ * the last read(), so the child is left right behind it. Stops early if
+ * compressed data was left unread, the position of the child is then
+ * undefined.
+ */
+void ZStream::finish_inflate() {
+    State &s = *m_state;
+    mz_stream &z = s.inflate_stream;
+    uint8_t dummy;
+    while (!s.inflate_done) {
+        if (z.avail_in == 0 && !refill())
+            break;
+        const unsigned int avail_in = z.avail_in;
+        z.next_out  = &dummy;
+        z.avail_out = 0;
+        int ret = mz_inflate(&z, MZ_NO_FLUSH);
+        if (ret == MZ_STREAM_END)
+            end_inflate();
+        else if ((ret != MZ_OK && ret != MZ_BUF_ERROR) || z.avail_in == avail_in)
+            break;
+    }
+}
+
+/// Serial mode: run the deflate stream over \c size bytes and write the output
+void ZStream::deflate_buffer(const void *p, size_t size, int flush) {
+    State &s = *m_state;
+    s.deflate_stream.next_in  = static_cast<const unsigned char *>(p);
+    s.deflate_stream.avail_in = static_cast<unsigned int>(size);
+    while (true) {
+        s.deflate_stream.next_out  = s.buffer.data();
+        s.deflate_stream.avail_out = static_cast<unsigned int>(s.buffer.size());
+        int ret = mz_deflate(&s.deflate_stream, flush);
+        if (ret != MZ_OK && ret != MZ_STREAM_END && ret != MZ_BUF_ERROR)
+            Throw("ZStream: deflate() failed: {}", mz_error(ret));
+        size_t output = s.buffer.size() - s.deflate_stream.avail_out;
+        if (output > 0)
+            m_child.write(s.buffer.data(), output);
+        if (flush == MZ_FINISH ? ret == MZ_STREAM_END
+                               : s.deflate_stream.avail_in == 0 && s.deflate_stream.avail_out > 0)
+            break;
+    }
+}
+
+/**
+ * Chunk-parallel mode: compress the pending batch as independent raw deflate
+ * chunks (full flush after each, the final one finishes the stream) and
+ * write them in order, followed by the Adler-32 trailer of the zlib stream
+ * when \c final.
+ */
+void ZStream::compress_batch(bool final) {
+    State &s = *m_state;
+    s.adler = mz_adler32(s.adler, s.batch.data(), s.batch.size());
+
+    const size_t size  = s.batch.size();
+    const int    count = std::max<int>((int) ((size + s.chunk - 1) / s.chunk), final ? 1 : 0);
+    std::vector<std::vector<uint8_t>> output(count);
+    bool failed = false;
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; ++i) {
+        const size_t begin = i * s.chunk, len = std::min(s.chunk, size - std::min(begin, size));
+        const int    flush = (final && i == count - 1) ? MZ_FINISH : MZ_FULL_FLUSH;
+        mz_stream    z;
+        memset(&z, 0, sizeof(z));
+        if (mz_deflateInit2(&z, s.level, MZ_DEFLATED, -MZ_DEFAULT_WINDOW_BITS, 9,
+                            MZ_DEFAULT_STRATEGY) != MZ_OK) {
+            failed = true;
+            continue;
+        }
+        std::vector<uint8_t> &out = output[i];
+        out.resize(mz_deflateBound(&z, len) + 64);
+        z.next_in   = s.batch.data() + begin;
+        z.avail_in  = static_cast<unsigned int>(len);
+        z.next_out  = out.data();
+        z.avail_out = static_cast<unsigned int>(out.size());
+        while (true) {
+            int ret = mz_deflate(&z, flush);
+            if (ret != MZ_OK && ret != MZ_STREAM_END && ret != MZ_BUF_ERROR) {
+                failed = true;
+                break;
+            }
+            if (flush == MZ_FINISH ? ret == MZ_STREAM_END : z.avail_in == 0 && z.avail_out > 0)
+                break;
+            size_t used = out.size() - z.avail_out;
+            out.resize(2 * out.size());
+            z.next_out  = out.data() + used;
+            z.avail_out = static_cast<unsigned int>(out.size() - used);
+        }
+        out.resize(out.size() - z.avail_out);
+        mz_deflateEnd(&z);
+    }
+    if (failed)
+        Throw("ZStream: parallel deflate() failed");
+
+    for (const auto &out : output)
+        m_child.write(out.data(), out.size());
+    s.batch.clear();
+
+    if (final) {
+        const uint8_t trailer[4] = { uint8_t(s.adler >> 24), uint8_t(s.adler >> 16),
+                                     uint8_t(s.adler >> 8), uint8_t(s.adler) };
+        m_child.write(trailer, 4);
+    }
+}
+
+void ZStream::write(const void *p, size_t size) {
+    State &s = *m_state;
+    if (m_mode != EDeflate)
+        Throw("ZStream: write() on a decompressing stream");
+    if (s.closed)
+        Throw("ZStream: write() after close()");
+    s.pos += size;
+
+    if (s.chunk > 0) {
+        const uint8_t *src = static_cast<const uint8_t *>(p);
+        write_header();
+        while (size > 0) {
+            size_t n = std::min(size, s.batch_size - s.batch.size());
+            s.batch.insert(s.batch.end(), src, src + n);
+            src += n;
+            size -= n;
+            if (s.batch.size() == s.batch_size)
+                compress_batch(false);
+        }
+        return;
+    }
+
+    init_deflate();
+    deflate_buffer(p, size, MZ_NO_FLUSH);
+}
+
+void ZStream::read(void *p, size_t size) {
+    State &s = *m_state;
+    if (m_mode != EInflate)
+        Throw("ZStream: read() on a compressing stream");
+    if (s.closed)
+        Throw("ZStream: read() after close()");
+    if (s.inflate_done && size > 0)
+        Throw("ZStream: read 0 out of {} bytes", size);
+    init_inflate();
+    mz_stream &z = s.inflate_stream;
+    z.next_out   = static_cast<unsigned char *>(p);
+    z.avail_out  = static_cast<unsigned int>(size);
+    while (z.avail_out > 0) {
+        if (z.avail_in == 0 && !refill())
+            Throw("ZStream: read {} out of {} bytes", size - z.avail_out, size);
+        int ret = mz_inflate(&z, MZ_NO_FLUSH);
+        if (ret == MZ_STREAM_END) {
+            end_inflate();
+            if (z.avail_out > 0)
+                Throw("ZStream: read {} out of {} bytes", size - z.avail_out, size);
+            break;
+        }
+        if (ret != MZ_OK && ret != MZ_BUF_ERROR)
+            Throw("ZStream: inflate() failed: {}", mz_error(ret));
+    }
+    s.pos += size;
+}
+
+void ZStream::seek(size_t) { Throw("ZStream: seek() is not supported"); }
+
+size_t ZStream::tell() const { return m_state->pos; }
+
+size_t ZStream::size() const { Throw("ZStream: size() is not supported"); }
+
+void ZStream::flush() {
+    State &s = *m_state;
+    if (m_mode == EDeflate && !s.closed) {
+        if (s.chunk > 0) {
+            if (!s.batch.empty())
+                compress_batch(false);
+        } else if (s.deflate_init) {
+            deflate_buffer(nullptr, 0, MZ_SYNC_FLUSH);
+        }
+    }
+    m_child.flush();
+}